@@ -1,4 +1,5 @@
 import 'dart:async';
+import 'dart:typed_data';
 
 import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart';
@@ -10,6 +11,36 @@ class SpeechToTextLinux extends SpeechToTextPlatform {
   static const MethodChannel _channel = MethodChannel('speech_to_text_linux');
   static bool _handlerRegistered = false;
 
+  /// Linux-specific options sent with every `listen` call, for example
+  /// `{'endpointSilenceMillis': 300}`. They override the defaults passed as
+  /// `SpeechConfigOption`s to `initialize`.
+  Map<String, dynamic> listenOptions = {};
+
+  /// Called with the JSON status of every native session, including ones
+  /// that are still finalizing after a newer `listen` took over. The JSON
+  /// carries `sessionId` and `status`, and `handleId` for sessions started
+  /// through [createSession].
+  void Function(String statusJson)? onSessionStatus;
+
+  /// Called with recognition results of sessions created by [createSession]
+  /// and of sessions that were superseded by a newer `listen`. The payload
+  /// matches `onTextRecognition` and carries the `sessionId` of the capture
+  /// it belongs to, plus the [createSession] id as `handleId`.
+  void Function(String resultJson)? onSessionTextRecognition;
+
+  /// Called with `{"sessionId":…,"handleId":…,"level":…}` for sessions
+  /// created by [createSession].
+  void Function(String levelJson)? onSessionSoundLevel;
+
+  /// Called after every final result with its word timings, when the
+  /// `wordTimings` listen option is set.
+  void Function(LinuxWordTimings timings)? onWordTimings;
+
+  /// Called after every result that covers known audio with its
+  /// `CLOCK_MONOTONIC` span, when the `audioSpans` listen option is set. The
+  /// `speech_to_text` facade's results drop these times.
+  void Function(LinuxAudioSpan span)? onAudioSpan;
+
   /// Registers this class as the default instance of [SpeechToTextPlatform].
   static void registerWith() {
     SpeechToTextPlatform.instance = SpeechToTextLinux();
@@ -69,6 +100,7 @@ class SpeechToTextLinux extends SpeechToTextPlatform {
       'cancelOnError': options?.cancelOnError ?? false,
       'pauseForMillis': options?.pauseFor?.inMilliseconds,
       'listenForMillis': options?.listenFor?.inMilliseconds,
+      ...listenOptions,
     };
 
     try {
@@ -122,6 +154,115 @@ class SpeechToTextLinux extends SpeechToTextPlatform {
     }
   }
 
+  /// Returns the native pipeline statistics, such as the
+  /// `endOfSpeechToFinal` latency, as reported by the Linux plugin.
+  Future<Map<String, dynamic>> stats() async {
+    try {
+      final Map<dynamic, dynamic>? result =
+          await _channel.invokeMethod<Map<dynamic, dynamic>>('stats');
+      return result?.cast<String, dynamic>() ?? const {};
+    } catch (error, stackTrace) {
+      if (kDebugMode) {
+        debugPrint('SpeechToTextLinux.stats error: $error\n$stackTrace');
+      }
+      return const {};
+    }
+  }
+
+  /// Creates a recognition session that can run concurrently with others,
+  /// for example one per headset. [options] take the same keys as
+  /// [listenOptions], including `inputDeviceIndex` or `inputDeviceName`, and
+  /// apply to every [listenSession] call. Returns the session id, or `null`.
+  Future<int?> createSession([Map<String, dynamic> options = const {}]) async {
+    try {
+      _ensureHandlerRegistered();
+      return await _channel.invokeMethod<int>('createSession', options);
+    } catch (error, stackTrace) {
+      if (kDebugMode) {
+        debugPrint('SpeechToTextLinux.createSession error: $error\n$stackTrace');
+      }
+      return null;
+    }
+  }
+
+  /// Starts capturing for a session created by [createSession]. Its events
+  /// arrive through the `onSession…` callbacks.
+  Future<bool> listenSession(int sessionId,
+      [Map<String, dynamic> options = const {}]) async {
+    try {
+      _ensureHandlerRegistered();
+      final bool? result = await _channel.invokeMethod<bool>(
+          'listen', {...options, 'sessionId': sessionId});
+      return result ?? false;
+    } catch (error, stackTrace) {
+      if (kDebugMode) {
+        debugPrint('SpeechToTextLinux.listenSession error: $error\n$stackTrace');
+      }
+      return false;
+    }
+  }
+
+  /// Stops the session and delivers its final result.
+  Future<void> stopSession(int sessionId) =>
+      _invokeSession('stop', sessionId);
+
+  /// Stops the session and discards its pending result.
+  Future<void> cancelSession(int sessionId) =>
+      _invokeSession('cancel', sessionId);
+
+  /// Cancels the session if needed and releases its id.
+  Future<void> destroySession(int sessionId) =>
+      _invokeSession('destroySession', sessionId);
+
+  /// Replaces the phrase list of a running grammar session (the implicit
+  /// one unless [sessionId] is given) without restarting it, starting with
+  /// the next utterance. Returns `false` when no such session is listening.
+  Future<bool> setGrammar(List<String> phrases, {int? sessionId}) async {
+    try {
+      _ensureHandlerRegistered();
+      final bool? result = await _channel.invokeMethod<bool>('setGrammar', {
+        'grammar': phrases,
+        if (sessionId != null) 'sessionId': sessionId,
+      });
+      return result ?? false;
+    } catch (error, stackTrace) {
+      if (kDebugMode) {
+        debugPrint('SpeechToTextLinux.setGrammar error: $error\n$stackTrace');
+      }
+      return false;
+    }
+  }
+
+  /// Lists the capture devices usable as `inputDeviceIndex` or
+  /// `inputDeviceName`. Empty until [initialize] succeeded.
+  Future<List<Map<String, dynamic>>> inputDevices() async {
+    try {
+      _ensureHandlerRegistered();
+      final List<dynamic>? result =
+          await _channel.invokeMethod<List<dynamic>>('inputDevices');
+      return result
+              ?.map((device) => (device as Map).cast<String, dynamic>())
+              .toList() ??
+          const [];
+    } catch (error, stackTrace) {
+      if (kDebugMode) {
+        debugPrint('SpeechToTextLinux.inputDevices error: $error\n$stackTrace');
+      }
+      return const [];
+    }
+  }
+
+  Future<void> _invokeSession(String method, int sessionId) async {
+    try {
+      _ensureHandlerRegistered();
+      await _channel.invokeMethod<void>(method, {'sessionId': sessionId});
+    } catch (error, stackTrace) {
+      if (kDebugMode) {
+        debugPrint('SpeechToTextLinux.$method error: $error\n$stackTrace');
+      }
+    }
+  }
+
   Map<String, dynamic> _mergeLinuxOptions(
       bool debugLogging, List<SpeechConfigOption>? options) {
     final Map<String, dynamic> params = {
@@ -160,6 +301,36 @@ class SpeechToTextLinux extends SpeechToTextPlatform {
             onStatus!(status);
           }
           break;
+        case 'sessionStatus':
+          final status = call.arguments;
+          if (status is String && onSessionStatus != null) {
+            onSessionStatus!(status);
+          }
+          break;
+        case 'sessionTextRecognition':
+          final payload = call.arguments;
+          if (payload is String && onSessionTextRecognition != null) {
+            onSessionTextRecognition!(payload);
+          }
+          break;
+        case 'sessionSoundLevel':
+          final level = call.arguments;
+          if (level is String && onSessionSoundLevel != null) {
+            onSessionSoundLevel!(level);
+          }
+          break;
+        case 'textRecognitionWords':
+          final payload = call.arguments;
+          if (payload is Map && onWordTimings != null) {
+            onWordTimings!(LinuxWordTimings.fromMap(payload));
+          }
+          break;
+        case 'textRecognitionSpan':
+          final payload = call.arguments;
+          if (payload is Map && onAudioSpan != null) {
+            onAudioSpan!(LinuxAudioSpan.fromMap(payload));
+          }
+          break;
         case 'soundLevelChange':
           final level = call.arguments;
           if (level is double && onSoundLevel != null) {
@@ -187,3 +358,75 @@ class SpeechToTextLinux extends SpeechToTextPlatform {
     _handlerRegistered = true;
   }
 }
+
+/// Word timings of one final result, as parallel lists: word `i` is
+/// [words]`[i]`, spoken from [start]`[i]` to [end]`[i]` seconds into the
+/// session's audio, with confidence [confidence]`[i]`. Times count from the
+/// session's first captured sample, whichever recognizer or pass produced
+/// the result, so words of successive finals line up on one timeline.
+/// [handleId] is the [SpeechToTextLinux.createSession] id, or 0.
+class LinuxWordTimings {
+  LinuxWordTimings({
+    required this.sessionId,
+    required this.handleId,
+    required this.recognizer,
+    required this.words,
+    required this.start,
+    required this.end,
+    required this.confidence,
+  });
+
+  factory LinuxWordTimings.fromMap(Map<Object?, Object?> map) {
+    return LinuxWordTimings(
+      sessionId: map['sessionId'] as int? ?? 0,
+      handleId: map['handleId'] as int? ?? 0,
+      recognizer: map['recognizer'] as String? ?? '',
+      words: (map['words'] as List<Object?>? ?? const []).cast<String>(),
+      start: map['start'] as Float64List? ?? Float64List(0),
+      end: map['end'] as Float64List? ?? Float64List(0),
+      confidence: map['conf'] as Float32List? ?? Float32List(0),
+    );
+  }
+
+  final int sessionId;
+  final int handleId;
+  final String recognizer;
+  final List<String> words;
+  final Float64List start;
+  final Float64List end;
+  final Float32List confidence;
+}
+
+/// The audio behind one result: [audioStartMillis] and [audioEndMillis] are
+/// the `CLOCK_MONOTONIC` times, in milliseconds, of its first and last
+/// captured sample, the same as the payload's `audioStartMillis` and
+/// `audioEndMillis`. [handleId] is the [SpeechToTextLinux.createSession] id,
+/// or 0.
+class LinuxAudioSpan {
+  LinuxAudioSpan({
+    required this.sessionId,
+    required this.handleId,
+    required this.recognizer,
+    required this.isFinal,
+    required this.audioStartMillis,
+    required this.audioEndMillis,
+  });
+
+  factory LinuxAudioSpan.fromMap(Map<Object?, Object?> map) {
+    return LinuxAudioSpan(
+      sessionId: map['sessionId'] as int? ?? 0,
+      handleId: map['handleId'] as int? ?? 0,
+      recognizer: map['recognizer'] as String? ?? '',
+      isFinal: map['final'] as bool? ?? false,
+      audioStartMillis: (map['audioStartMillis'] as num?)?.toDouble() ?? -1,
+      audioEndMillis: (map['audioEndMillis'] as num?)?.toDouble() ?? -1,
+    );
+  }
+
+  final int sessionId;
+  final int handleId;
+  final String recognizer;
+  final bool isFinal;
+  final double audioStartMillis;
+  final double audioEndMillis;
+}
@@ -0,0 +1,243 @@
+#include "audio_capture.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace speech_to_text_linux {
+
+ChunkPool::Store::~Store() {
+  for (AudioChunk* chunk : chunks) {
+    delete chunk;
+  }
+  for (void* block : blocks) {
+    ::operator delete(block);
+  }
+}
+
+template <typename T>
+T* ChunkPool::BlockAllocator<T>::allocate(size_t count) {
+  const size_t bytes = count * sizeof(T);
+  {
+    std::lock_guard<std::mutex> lock(store->mutex);
+    if (store->block_size == 0) {
+      store->block_size = bytes;
+    }
+    if (bytes == store->block_size && !store->blocks.empty()) {
+      void* block = store->blocks.back();
+      store->blocks.pop_back();
+      return static_cast<T*>(block);
+    }
+  }
+  store->misses.fetch_add(1);
+  return static_cast<T*>(::operator new(bytes));
+}
+
+template <typename T>
+void ChunkPool::BlockAllocator<T>::deallocate(T* block, size_t count) {
+  {
+    std::lock_guard<std::mutex> lock(store->mutex);
+    if (count * sizeof(T) == store->block_size) {
+      store->blocks.push_back(block);
+      return;
+    }
+  }
+  ::operator delete(block);
+}
+
+void ChunkPool::Recycler::operator()(AudioChunk* chunk) const {
+  std::lock_guard<std::mutex> lock(store->mutex);
+  store->chunks.push_back(chunk);
+}
+
+std::shared_ptr<AudioChunk> ChunkPool::Take() {
+  AudioChunk* chunk = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(store_->mutex);
+    if (!store_->chunks.empty()) {
+      chunk = store_->chunks.back();
+      store_->chunks.pop_back();
+    }
+  }
+  if (chunk == nullptr) {
+    store_->misses.fetch_add(1);
+    chunk = new AudioChunk();
+  }
+  return std::shared_ptr<AudioChunk>(chunk, Recycler{store_},
+                                     BlockAllocator<AudioChunk>(store_));
+}
+
+// Maps a mean square of normalized samples onto the 0..120 level scale
+// reported through `soundLevelChange`.
+static double MeanSquareToLevel(double mean_square) {
+  const double rms = std::sqrt(mean_square);
+  double db = 20.0 * std::log10(rms + 1e-9) + 90.0;
+  if (!std::isfinite(db) || db < 0.0) {
+    db = 0.0;
+  }
+  if (db > 120.0) {
+    db = 120.0;
+  }
+  return db;
+}
+
+double ComputeSoundLevel(const int16_t* buffer, int frames) {
+  if (buffer == nullptr || frames <= 0) {
+    return 0.0;
+  }
+  double accum = 0.0;
+  for (int i = 0; i < frames; ++i) {
+    const double normalized = static_cast<double>(buffer[i]) / 32768.0;
+    accum += normalized * normalized;
+  }
+  return MeanSquareToLevel(accum / frames);
+}
+
+// Frames quieter than this (about -60 dBFS) never count as speech, however
+// low the noise floor drops.
+constexpr double kMinSpeechLevel = 30.0;
+
+void EnergyEndpointer::Configure(int sample_rate, std::chrono::milliseconds trailing_silence,
+                                 double threshold_db) {
+  frame_samples_ = std::max(1, sample_rate / 100);
+  trailing_frames_ = static_cast<int>(trailing_silence.count() / 10);
+  threshold_db_ = threshold_db > 0.0 ? threshold_db : 12.0;
+  Reset();
+}
+
+void EnergyEndpointer::Reset() {
+  noise_floor_db_ = -1.0;
+  in_speech_ = false;
+  heard_speech_ = false;
+  voiced_run_ = 0;
+  silent_run_ = 0;
+  frame_fill_ = 0;
+  frame_accum_ = 0.0;
+  processed_samples_ = 0;
+  last_voiced_end_ = 0;
+}
+
+EnergyEndpointer::Event EnergyEndpointer::Process(const int16_t* data, int frames) {
+  Event result = Event::kNone;
+  if (data == nullptr) {
+    return result;
+  }
+  for (int i = 0; i < frames; ++i) {
+    const double normalized = static_cast<double>(data[i]) / 32768.0;
+    frame_accum_ += normalized * normalized;
+    processed_samples_++;
+    if (++frame_fill_ < frame_samples_) {
+      continue;
+    }
+    const Event event = ClassifyFrame(frame_accum_ / frame_fill_);
+    frame_fill_ = 0;
+    frame_accum_ = 0.0;
+    if (event == Event::kEndOfSpeech || (event != Event::kNone && result == Event::kNone)) {
+      result = event;
+    }
+  }
+  return result;
+}
+
+EnergyEndpointer::Event EnergyEndpointer::ClassifyFrame(double mean_square) {
+  const double level = MeanSquareToLevel(mean_square);
+  if (noise_floor_db_ < 0.0) {
+    noise_floor_db_ = level;
+  }
+  const bool voiced = level >= kMinSpeechLevel && level > noise_floor_db_ + threshold_db_;
+  if (level < noise_floor_db_) {
+    // Drop quickly when it gets quieter, rise slowly through non-speech.
+    noise_floor_db_ = 0.7 * noise_floor_db_ + 0.3 * level;
+  } else if (!voiced) {
+    noise_floor_db_ += 0.01 * (level - noise_floor_db_);
+  }
+
+  if (voiced) {
+    voiced_run_++;
+    silent_run_ = 0;
+    if (heard_speech_ || voiced_run_ >= min_speech_frames_) {
+      last_voiced_end_ = processed_samples_;
+    }
+    if (!in_speech_ && voiced_run_ >= min_speech_frames_) {
+      in_speech_ = true;
+      heard_speech_ = true;
+      return Event::kSpeechStart;
+    }
+    return Event::kNone;
+  }
+  voiced_run_ = 0;
+  if (!in_speech_) {
+    return Event::kNone;
+  }
+  silent_run_++;
+  if (trailing_frames_ > 0 && silent_run_ >= trailing_frames_) {
+    in_speech_ = false;
+    return Event::kEndOfSpeech;
+  }
+  return Event::kNone;
+}
+
+AudioRing::AudioRing(size_t min_capacity) {
+  size_t capacity = 1;
+  while (capacity < min_capacity) {
+    capacity <<= 1;
+  }
+  buffer_.resize(capacity);
+  mask_ = capacity - 1;
+}
+
+size_t AudioRing::Write(const int16_t* data, size_t count) {
+  const size_t write = write_pos_.load(std::memory_order_relaxed);
+  const size_t read = read_pos_.load(std::memory_order_acquire);
+  const size_t stored = std::min(count, buffer_.size() - (write - read));
+  if (stored > 0 && unplaced_ > 0) {
+    const size_t gaps = gaps_written_.load(std::memory_order_relaxed);
+    if (gaps - gaps_read_.load(std::memory_order_acquire) < kMaxRingGaps) {
+      gaps_[gaps % kMaxRingGaps] = Gap{write, unplaced_};
+      gaps_written_.store(gaps + 1, std::memory_order_release);
+      unplaced_ = 0;
+    }
+  }
+  const size_t offset = write & mask_;
+  const size_t first = std::min(stored, buffer_.size() - offset);
+  std::copy(data, data + first, buffer_.begin() + offset);
+  std::copy(data + first, data + stored, buffer_.begin());
+  write_pos_.store(write + stored, std::memory_order_release);
+  if (stored < count) {
+    dropped_.fetch_add(count - stored, std::memory_order_relaxed);
+    unplaced_ += count - stored;
+  }
+  return stored;
+}
+
+size_t AudioRing::Read(int16_t* out, size_t max_count, uint64_t* skipped) {
+  const size_t read = read_pos_.load(std::memory_order_relaxed);
+  const size_t write = write_pos_.load(std::memory_order_acquire);
+  size_t taken = std::min(max_count, write - read);
+  // Gaps are placed before the samples behind them are published.
+  size_t gaps_read = gaps_read_.load(std::memory_order_relaxed);
+  const size_t gaps = gaps_written_.load(std::memory_order_acquire);
+  for (; gaps_read != gaps; ++gaps_read) {
+    const Gap& gap = gaps_[gaps_read % kMaxRingGaps];
+    if (gap.at != read) {
+      taken = std::min(taken, gap.at - read);
+      break;
+    }
+    if (skipped != nullptr) {
+      *skipped += gap.count;
+    }
+  }
+  gaps_read_.store(gaps_read, std::memory_order_release);
+  const size_t offset = read & mask_;
+  const size_t first = std::min(taken, buffer_.size() - offset);
+  std::copy(buffer_.begin() + offset, buffer_.begin() + offset + first, out);
+  std::copy(buffer_.begin(), buffer_.begin() + (taken - first), out + first);
+  read_pos_.store(read + taken, std::memory_order_release);
+  return taken;
+}
+
+size_t AudioRing::Available() const {
+  return write_pos_.load(std::memory_order_acquire) -
+         read_pos_.load(std::memory_order_acquire);
+}
+
+}  // namespace speech_to_text_linux
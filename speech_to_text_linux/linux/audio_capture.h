@@ -0,0 +1,156 @@
+#ifndef SPEECH_TO_TEXT_LINUX_AUDIO_CAPTURE_H_
+#define SPEECH_TO_TEXT_LINUX_AUDIO_CAPTURE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace speech_to_text_linux {
+
+// Frame-energy voice activity detector. It classifies 10 ms frames against an
+// adaptive noise floor so a session can be finalized as soon as the speaker
+// stops, rather than when the recognizer's partial text stops changing.
+class EnergyEndpointer {
+ public:
+  enum class Event { kNone, kSpeechStart, kEndOfSpeech };
+
+  // A zero |trailing_silence| keeps tracking voice activity but never reports
+  // kEndOfSpeech.
+  void Configure(int sample_rate, std::chrono::milliseconds trailing_silence,
+                 double threshold_db);
+  void Reset();
+  Event Process(const int16_t* data, int frames);
+
+  bool heard_speech() const { return heard_speech_; }
+  // Samples fed since the end of the last voiced frame.
+  int64_t samples_since_voice() const { return processed_samples_ - last_voiced_end_; }
+
+ private:
+  Event ClassifyFrame(double mean_square);
+
+  int frame_samples_ = 160;
+  int trailing_frames_ = 0;
+  int min_speech_frames_ = 3;
+  double threshold_db_ = 12.0;
+  double noise_floor_db_ = -1.0;
+  bool in_speech_ = false;
+  bool heard_speech_ = false;
+  int voiced_run_ = 0;
+  int silent_run_ = 0;
+  int frame_fill_ = 0;
+  double frame_accum_ = 0.0;
+  int64_t processed_samples_ = 0;
+  int64_t last_voiced_end_ = 0;
+};
+
+// Gaps the ring remembers until the reader passes them; more are folded
+// into a later gap.
+constexpr size_t kMaxRingGaps = 16;
+
+// Lock-free single-producer/single-consumer ring of samples. The PortAudio
+// callback writes into it and the session's decode tasks drain it.
+class AudioRing {
+ public:
+  explicit AudioRing(size_t min_capacity);
+
+  // Returns how many samples were stored; the remainder is dropped.
+  size_t Write(const int16_t* data, size_t count);
+  // Reads stop short of a gap left by dropped samples, so every read is
+  // contiguous audio; the samples dropped right before it are added to
+  // |skipped|.
+  size_t Read(int16_t* out, size_t max_count, uint64_t* skipped = nullptr);
+  size_t Available() const;
+  size_t capacity() const { return buffer_.size(); }
+  uint64_t dropped_samples() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  std::vector<int16_t> buffer_;
+  size_t mask_ = 0;
+  std::atomic<size_t> write_pos_{0};
+  std::atomic<size_t> read_pos_{0};
+  std::atomic<uint64_t> dropped_{0};
+  // |count| samples were dropped right before ring position |at|. A gap is
+  // placed once the next sample is stored, so drops while the ring stays
+  // full make one gap; |unplaced_| is the writer's count until then.
+  struct Gap {
+    size_t at;
+    uint64_t count;
+  };
+  Gap gaps_[kMaxRingGaps];
+  std::atomic<size_t> gaps_written_{0};
+  std::atomic<size_t> gaps_read_{0};
+  uint64_t unplaced_ = 0;
+};
+
+// Immutable block of captured audio. The capture stage publishes one
+// reference to every recognizer of a session, so they all decode the same
+// samples without copying them.
+struct AudioChunk {
+  std::vector<int16_t> samples;
+  std::chrono::steady_clock::time_point captured_at;
+  // Stream position of the first sample, for result timestamps.
+  int64_t first_sample = 0;
+};
+using AudioChunkRef = std::shared_ptr<const AudioChunk>;
+
+// Recycles a session's audio chunks along with their sample buffers and
+// shared_ptr control blocks, so publishing a chunk stops allocating once
+// the pool has warmed up. A chunk returns to the pool on whichever thread
+// drops its last reference; the storage outlives the pool if it has to.
+class ChunkPool {
+ public:
+  std::shared_ptr<AudioChunk> Take();
+  // Chunks and control blocks that had to be allocated.
+  int64_t misses() const { return store_->misses.load(); }
+
+ private:
+  struct Store {
+    ~Store();
+
+    std::mutex mutex;
+    std::vector<AudioChunk*> chunks;
+    std::vector<void*> blocks;
+    size_t block_size = 0;
+    std::atomic<int64_t> misses{0};
+  };
+
+  // Hands out recycled control blocks. It keeps the store alive because
+  // shared_ptr frees the block after running the deleter.
+  template <typename T>
+  struct BlockAllocator {
+    using value_type = T;
+
+    explicit BlockAllocator(std::shared_ptr<Store> store) : store(std::move(store)) {}
+    template <typename U>
+    BlockAllocator(const BlockAllocator<U>& other) : store(other.store) {}
+
+    T* allocate(size_t count);
+    void deallocate(T* block, size_t count);
+
+    std::shared_ptr<Store> store;
+  };
+  template <typename T, typename U>
+  friend bool operator==(const BlockAllocator<T>& a, const BlockAllocator<U>& b) {
+    return a.store == b.store;
+  }
+  template <typename T, typename U>
+  friend bool operator!=(const BlockAllocator<T>& a, const BlockAllocator<U>& b) {
+    return a.store != b.store;
+  }
+
+  struct Recycler {
+    void operator()(AudioChunk* chunk) const;
+    std::shared_ptr<Store> store;
+  };
+
+  std::shared_ptr<Store> store_ = std::make_shared<Store>();
+};
+
+double ComputeSoundLevel(const int16_t* buffer, int frames);
+
+}  // namespace speech_to_text_linux
+
+#endif  // SPEECH_TO_TEXT_LINUX_AUDIO_CAPTURE_H_
@@ -0,0 +1,123 @@
+#include "audio_device.h"
+
+#include <atomic>
+#include <future>
+#include <sstream>
+#include <thread>
+
+namespace speech_to_text_linux {
+
+// Pa_Initialize probes every host API, ALSA cards and JACK included, which
+// can take hundreds of milliseconds. Plugin instances share one
+// initialization: only the first reference probes and the last terminates.
+static std::mutex port_audio_mutex;
+static int port_audio_refs = 0;
+
+PaError AcquirePortAudio() {
+  std::lock_guard<std::mutex> lock(port_audio_mutex);
+  if (port_audio_refs == 0) {
+    const PaError error = Pa_Initialize();
+    if (error != paNoError) {
+      return error;
+    }
+  }
+  port_audio_refs++;
+  return paNoError;
+}
+
+void ReleasePortAudio() {
+  std::lock_guard<std::mutex> lock(port_audio_mutex);
+  if (port_audio_refs > 0 && --port_audio_refs == 0) {
+    Pa_Terminate();
+  }
+}
+
+std::string DescribePaError(PaError error_code) {
+  std::ostringstream oss;
+  oss << "PortAudio error (" << error_code << "): " << Pa_GetErrorText(error_code);
+  return oss.str();
+}
+
+std::string ListAvailableInputDevices() {
+  const PaError count = Pa_GetDeviceCount();
+  if (count < 0) {
+    return DescribePaError(count);
+  }
+  if (count == 0) {
+    return "No input devices detected.";
+  }
+  std::ostringstream oss;
+  for (int i = 0; i < count; ++i) {
+    const PaDeviceInfo* info = Pa_GetDeviceInfo(i);
+    if (info == nullptr || info->maxInputChannels <= 0) {
+      continue;
+    }
+    const PaHostApiInfo* api_info = Pa_GetHostApiInfo(info->hostApi);
+    oss << "[" << i << "] " << (info->name != nullptr ? info->name : "unknown")
+        << " (API: " << (api_info != nullptr && api_info->name != nullptr ? api_info->name : "unknown")
+        << ", channels: " << info->maxInputChannels
+        << ", default SR: " << info->defaultSampleRate << ")\n";
+  }
+  std::string result = oss.str();
+  if (result.empty()) {
+    return "No input-capable devices detected.";
+  }
+  return result;
+}
+
+PaDeviceIndex FindInputDevice(gint64 index, const std::string& name) {
+  const PaDeviceIndex count = Pa_GetDeviceCount();
+  if (index >= 0) {
+    if (index >= count) {
+      return paNoDevice;
+    }
+    const PaDeviceInfo* info = Pa_GetDeviceInfo(static_cast<PaDeviceIndex>(index));
+    return info != nullptr && info->maxInputChannels > 0 ? static_cast<PaDeviceIndex>(index)
+                                                         : paNoDevice;
+  }
+  if (!name.empty()) {
+    for (PaDeviceIndex i = 0; i < count; ++i) {
+      const PaDeviceInfo* info = Pa_GetDeviceInfo(i);
+      if (info != nullptr && info->maxInputChannels > 0 && info->name != nullptr &&
+          std::string(info->name).find(name) != std::string::npos) {
+        return i;
+      }
+    }
+    return paNoDevice;
+  }
+  return Pa_GetDefaultInputDevice();
+}
+
+StreamOpenResult OpenInputStreamWithTimeout(
+    const std::shared_ptr<std::mutex>& device_mutex, const PaStreamParameters& params,
+    int sample_rate, unsigned long frames_per_buffer, PaStreamCallback* callback,
+    void* user_data, std::chrono::milliseconds timeout) {
+  auto promise =
+      std::make_shared<std::promise<StreamOpenResult>>();
+  std::future<StreamOpenResult> future = promise->get_future();
+  auto cancelled = std::make_shared<std::atomic<bool>>(false);
+  std::thread([device_mutex, promise, cancelled, params, sample_rate,
+               frames_per_buffer, callback, user_data]() {
+    std::lock_guard<std::mutex> device_lock(*device_mutex);
+    PaStream* stream = nullptr;
+    PaError err =
+        Pa_OpenStream(&stream, &params, nullptr, sample_rate,
+                      frames_per_buffer, paClipOff, callback, user_data);
+    if (cancelled->load()) {
+      if (stream != nullptr) {
+        Pa_CloseStream(stream);
+        stream = nullptr;
+      }
+    }
+    promise->set_value(StreamOpenResult{err, stream});
+  }).detach();
+  if (future.wait_for(timeout) == std::future_status::timeout) {
+    cancelled->store(true);
+    return StreamOpenResult{paTimedOut, nullptr, true};
+  }
+  auto result = future.get();
+  result.timed_out = false;
+  return result;
+}
+
+}  // namespace speech_to_text_linux
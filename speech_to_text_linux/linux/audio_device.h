@@ -0,0 +1,41 @@
+#ifndef SPEECH_TO_TEXT_LINUX_AUDIO_DEVICE_H_
+#define SPEECH_TO_TEXT_LINUX_AUDIO_DEVICE_H_
+
+#include <glib.h>
+#include <portaudio.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace speech_to_text_linux {
+
+struct StreamOpenResult {
+  PaError error;
+  PaStream* stream;
+  bool timed_out;
+};
+
+PaError AcquirePortAudio();
+
+void ReleasePortAudio();
+
+std::string DescribePaError(PaError error_code);
+
+std::string ListAvailableInputDevices();
+
+// Resolves `inputDeviceIndex` or a case-sensitive `inputDeviceName`
+// substring to a PortAudio input device, falling back to the default input.
+PaDeviceIndex FindInputDevice(gint64 index, const std::string& name);
+
+// Opens a stream on a helper thread that holds |device_mutex| for the
+// PortAudio calls, giving up after |timeout|.
+StreamOpenResult OpenInputStreamWithTimeout(
+    const std::shared_ptr<std::mutex>& device_mutex, const PaStreamParameters& params,
+    int sample_rate, unsigned long frames_per_buffer, PaStreamCallback* callback,
+    void* user_data, std::chrono::milliseconds timeout);
+
+}  // namespace speech_to_text_linux
+
+#endif  // SPEECH_TO_TEXT_LINUX_AUDIO_DEVICE_H_
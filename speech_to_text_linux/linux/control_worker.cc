@@ -0,0 +1,126 @@
+#include "control_worker.h"
+
+#include <iterator>
+
+namespace speech_to_text_linux {
+
+ControlWorker::ControlWorker()
+    : blocking_thread_([this]() { RunBlocking(); }), cheap_thread_([this]() { RunCheap(); }) {}
+
+ControlWorker::~ControlWorker() {
+  Shutdown();
+  blocking_thread_.join();
+  cheap_thread_.join();
+}
+
+void ControlWorker::Shutdown() {
+  std::deque<Queued> dropped;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    dropped.swap(blocking_jobs_);
+    std::move(cheap_jobs_.begin(), cheap_jobs_.end(), std::back_inserter(dropped));
+    cheap_jobs_.clear();
+  }
+  cv_.notify_all();
+  for (Queued& queued : dropped) {
+    queued.job.drop();
+  }
+}
+
+void ControlWorker::PostBlocking(Job job) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopping_) {
+      lock.unlock();
+      job.drop();
+      return;
+    }
+    blocking_posted_++;
+    blocking_jobs_.push_back(Queued{std::move(job), cheap_posted_});
+  }
+  cv_.notify_all();
+}
+
+void ControlWorker::PostCheap(Job job) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (stopping_) {
+    lock.unlock();
+    job.drop();
+    return;
+  }
+  cheap_posted_++;
+  if (blocking_settled_ < blocking_posted_ || !cheap_jobs_.empty() ||
+      cheap_done_ + 1 < cheap_posted_) {
+    cheap_jobs_.push_back(Queued{std::move(job), blocking_posted_});
+    lock.unlock();
+    cv_.notify_all();
+    return;
+  }
+  lock.unlock();
+  job.run();
+  lock.lock();
+  cheap_done_++;
+  lock.unlock();
+  cv_.notify_all();
+}
+
+void ControlWorker::Settle() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SettleLocked();
+  }
+  cv_.notify_all();
+}
+
+void ControlWorker::SettleLocked() {
+  if (blocking_running_) {
+    blocking_running_ = false;
+    blocking_settled_++;
+  }
+}
+
+void ControlWorker::RunBlocking() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this]() {
+      return stopping_ ||
+             (!blocking_jobs_.empty() && cheap_done_ >= blocking_jobs_.front().after);
+    });
+    if (stopping_) {
+      return;
+    }
+    Job job = std::move(blocking_jobs_.front().job);
+    blocking_jobs_.pop_front();
+    blocking_running_ = true;
+    lock.unlock();
+    job.run();
+    job = Job();
+    lock.lock();
+    SettleLocked();
+    cv_.notify_all();
+  }
+}
+
+void ControlWorker::RunCheap() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this]() {
+      return stopping_ ||
+             (!cheap_jobs_.empty() && blocking_settled_ >= cheap_jobs_.front().after);
+    });
+    if (stopping_) {
+      return;
+    }
+    Job job = std::move(cheap_jobs_.front().job);
+    cheap_jobs_.pop_front();
+    lock.unlock();
+    job.run();
+    job = Job();
+    lock.lock();
+    cheap_done_++;
+    cv_.notify_all();
+  }
+}
+
+}  // namespace speech_to_text_linux
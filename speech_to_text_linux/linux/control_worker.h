@@ -0,0 +1,76 @@
+#ifndef SPEECH_TO_TEXT_LINUX_CONTROL_WORKER_H_
+#define SPEECH_TO_TEXT_LINUX_CONTROL_WORKER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace speech_to_text_linux {
+
+// Runs method calls away from the platform thread. Calls that can block,
+// such as loading a model or opening a device, run one at a time on their
+// own thread. Cheap calls (`stop`, `stats`, ...) never queue behind those:
+// they only wait until every blocking call made before them has settled,
+// which `listen` does once its session is registered. So every call still
+// sees the effects of the ones made before it, e.g. `stop` right after
+// `listen`, without waiting for the device to open. A cheap call with
+// nothing to wait for runs right away on the posting thread; the others
+// wait on a second thread. A blocking call in turn waits for the cheap
+// calls made before it.
+class ControlWorker {
+ public:
+  struct Job {
+    std::function<void()> run;
+    // Runs instead of |run| for a job still queued at shutdown, on the
+    // thread calling Shutdown, or posted after it.
+    std::function<void()> drop;
+  };
+
+  ControlWorker();
+  // Lets the running jobs finish and drops the queued ones.
+  ~ControlWorker();
+  ControlWorker(const ControlWorker&) = delete;
+  ControlWorker& operator=(const ControlWorker&) = delete;
+
+  // Drops the queued jobs without waiting for the running ones, which the
+  // destructor still joins.
+  void Shutdown();
+
+  void PostBlocking(Job job);
+  void PostCheap(Job job);
+  // Called by the running blocking job once later calls may go ahead; it
+  // counts as settled anyway when it returns.
+  void Settle();
+
+ private:
+  struct Queued {
+    Job job;
+    // Jobs of the other kind that must be done (cheap) or settled
+    // (blocking) first.
+    uint64_t after;
+  };
+
+  void RunBlocking();
+  void RunCheap();
+  void SettleLocked();
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Queued> blocking_jobs_;
+  std::deque<Queued> cheap_jobs_;
+  uint64_t blocking_posted_ = 0;
+  uint64_t blocking_settled_ = 0;
+  bool blocking_running_ = false;
+  uint64_t cheap_posted_ = 0;
+  uint64_t cheap_done_ = 0;
+  bool stopping_ = false;
+  std::thread blocking_thread_;
+  std::thread cheap_thread_;
+};
+
+}  // namespace speech_to_text_linux
+
+#endif  // SPEECH_TO_TEXT_LINUX_CONTROL_WORKER_H_
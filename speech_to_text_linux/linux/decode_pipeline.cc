@@ -0,0 +1,1705 @@
+#include "decode_pipeline.h"
+
+#include <glib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <thread>
+
+#include "audio_capture.h"
+#include "audio_device.h"
+#include "json_payloads.h"
+
+namespace speech_to_text_linux {
+
+void DebugLog(PluginCore* self, const std::string& message) {
+  if (self == nullptr || self->state == nullptr || !self->state->debug_logging) {
+    return;
+  }
+  g_message("speech_to_text_linux: %s", message.c_str());
+}
+
+static void PostEvent(PluginCore* self, const char* method,
+                      const std::string* payload, double value) {
+  if (self == nullptr || self->events == nullptr) {
+    return;
+  }
+  if (self->events->Post(method, payload, value)) {
+    g_source_set_ready_time(self->event_source, 0);
+  }
+}
+
+// Takes over |typed|.
+static void InvokeTypedOnMain(PluginCore* self, const char* method,
+                              FlValue* typed) {
+  if (self == nullptr || self->events == nullptr) {
+    fl_value_unref(typed);
+    return;
+  }
+  if (self->events->PostTyped(method, typed)) {
+    g_source_set_ready_time(self->event_source, 0);
+  }
+}
+
+static void InvokeStringOnMain(PluginCore* self, const char* method,
+                               const std::string& payload) {
+  PostEvent(self, method, &payload, 0.0);
+}
+
+static void InvokeDoubleOnMain(PluginCore* self, const char* method,
+                               double value) {
+  PostEvent(self, method, nullptr, value);
+}
+
+static void SendStatus(PluginCore* self, const std::string& status) {
+  InvokeStringOnMain(self, "notifyStatus", status);
+}
+
+void SendError(PluginCore* self, const std::string& message,
+               bool permanent) {
+  InvokeStringOnMain(self, "notifyError", BuildErrorJson(message, permanent));
+}
+
+// Only the most recently started session reports through the legacy
+// callbacks; a session still finalizing after it was superseded would
+// otherwise be mistaken for the new one by the Dart side.
+static bool IsCurrentSession(PluginCore* self, const RecognitionSession* session) {
+  return self->state->current_session_id.load() == session->id;
+}
+
+void SendSessionStatus(PluginCore* self, const RecognitionSession* session,
+                       const std::string& status) {
+  if (IsCurrentSession(self, session)) {
+    SendStatus(self, status);
+  }
+  InvokeStringOnMain(self, "sessionStatus", BuildSessionStatusJson(session->id, session->handle_id, status));
+}
+
+void SendSessionError(PluginCore* self, const RecognitionSession* session,
+                      const std::string& message, bool permanent) {
+  if (IsCurrentSession(self, session)) {
+    SendError(self, message, permanent);
+  }
+  InvokeStringOnMain(self, "sessionStatus",
+                     BuildSessionErrorJson(session->id, session->handle_id, message, permanent));
+}
+
+// Payloads are built in per-thread buffers that keep their capacity, so the
+// decode hot path does not allocate for them.
+static thread_local std::string tls_payload;
+
+// Sends the audio span of a result as a typed map, for apps on the
+// `speech_to_text` facade, whose results drop the payload's
+// `audioStartMillis` and `audioEndMillis`:
+// `{sessionId, recognizer, final, audioStartMillis, audioEndMillis}`.
+static void SendAudioSpan(PluginCore* self, const RecognitionSession* session,
+                          const std::string& recognizer, bool final_result,
+                          const AudioSpan& span) {
+  if (!session->audio_spans || !span.known()) {
+    return;
+  }
+  FlValue* payload = fl_value_new_map();
+  fl_value_set_string_take(payload, "sessionId", fl_value_new_int(session->id));
+  if (session->handle_id != 0) {
+    fl_value_set_string_take(payload, "handleId", fl_value_new_int(session->handle_id));
+  }
+  fl_value_set_string_take(payload, "recognizer", fl_value_new_string(recognizer.c_str()));
+  fl_value_set_string_take(payload, "final", fl_value_new_bool(final_result));
+  fl_value_set_string_take(payload, "audioStartMillis", fl_value_new_float(span.start_ms));
+  fl_value_set_string_take(payload, "audioEndMillis", fl_value_new_float(span.end_ms));
+  InvokeTypedOnMain(self, "textRecognitionSpan", payload);
+}
+
+static void SendRecognitionAs(PluginCore* self, const RecognitionSession* session,
+                              const std::string& recognizer, const std::string& text,
+                              double confidence, bool final_result, const AudioSpan& span,
+                              const std::vector<Alternative>* alternates = nullptr) {
+  SpeechToTextLinuxPluginState* state = self->state;
+  if (!state->first_result_sent.load(std::memory_order_relaxed) &&
+      !state->first_result_sent.exchange(true)) {
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - state->created_at;
+    std::lock_guard<std::mutex> lock(state->stats.mutex);
+    state->stats.first_recognition_ms = elapsed.count();
+  }
+  BuildRecognitionPayload(&tls_payload, text, confidence, final_result, session->id,
+                          session->handle_id, recognizer, span, alternates);
+  InvokeStringOnMain(
+      self, IsCurrentSession(self, session) ? "textRecognition" : "sessionTextRecognition",
+      tls_payload);
+  SendAudioSpan(self, session, recognizer, final_result, span);
+}
+
+static void SendRecognition(PluginCore* self, const RecognitionSession* session,
+                            const std::string& text, double confidence, bool final_result,
+                            const AudioSpan& span) {
+  SendRecognitionAs(self, session, session->recognizer_name, text, confidence, final_result,
+                    span);
+}
+
+// Lane results never use the legacy callback, which knows one recognizer.
+static void SendLaneRecognition(PluginCore* self,
+                                const RecognitionSession* session, const RecognizerLane* lane,
+                                const std::string& text, double confidence, bool final_result,
+                                const AudioSpan& span) {
+  BuildRecognitionPayload(&tls_payload, text, confidence, final_result, session->id,
+                          session->handle_id, lane->name, span);
+  InvokeStringOnMain(self, "sessionTextRecognition", tls_payload);
+  SendAudioSpan(self, session, lane->name, final_result, span);
+}
+
+static thread_local std::vector<Alternative> tls_alternatives;
+
+// Sends the word timings of a final as parallel typed lists, so the Dart
+// side can highlight words without parsing or aligning anything:
+// `{sessionId, recognizer, words, start, end, conf}`. |timings| are on the
+// session's timeline, in seconds since the stream's first sample.
+static void SendWordTimings(PluginCore* self, const RecognitionSession* session,
+                            const std::string& recognizer,
+                            const std::vector<WordTiming>& timings) {
+  if (!session->word_timings || timings.empty()) {
+    return;
+  }
+  const size_t count = timings.size();
+  std::vector<double> starts(count);
+  std::vector<double> ends(count);
+  std::vector<float> confidences(count);
+  FlValue* words = fl_value_new_list();
+  for (size_t i = 0; i < count; ++i) {
+    fl_value_append_take(words, fl_value_new_string(timings[i].word.c_str()));
+    starts[i] = timings[i].start;
+    ends[i] = timings[i].end;
+    confidences[i] = static_cast<float>(timings[i].conf);
+  }
+  FlValue* payload = fl_value_new_map();
+  fl_value_set_string_take(payload, "sessionId", fl_value_new_int(session->id));
+  if (session->handle_id != 0) {
+    fl_value_set_string_take(payload, "handleId", fl_value_new_int(session->handle_id));
+  }
+  fl_value_set_string_take(payload, "recognizer", fl_value_new_string(recognizer.c_str()));
+  fl_value_set_string_take(payload, "words", words);
+  fl_value_set_string_take(payload, "start", fl_value_new_float_list(starts.data(), count));
+  fl_value_set_string_take(payload, "end", fl_value_new_float_list(ends.data(), count));
+  fl_value_set_string_take(payload, "conf",
+                           fl_value_new_float32_list(confidences.data(), count));
+  InvokeTypedOnMain(self, "textRecognitionWords", payload);
+}
+
+static void SendSoundLevel(PluginCore* self, const RecognitionSession* session,
+                           double level) {
+  if (IsCurrentSession(self, session)) {
+    InvokeDoubleOnMain(self, "soundLevelChange", level);
+  } else if (session->handle_id != 0) {
+    BuildSessionSoundLevelJson(&tls_payload, session->id, session->handle_id, level);
+    InvokeStringOnMain(self, "sessionSoundLevel", tls_payload);
+  }
+}
+
+void SendListenError(PluginCore* self, int64_t handle_id,
+                     const std::string& message) {
+  if (handle_id == 0) {
+    SendError(self, message, true);
+  } else {
+    InvokeStringOnMain(self, "sessionStatus", BuildSessionErrorJson(0, handle_id, message, true));
+  }
+}
+
+// Updates the endpointing stats once the final result of a session is out.
+static void RecordSessionEnd(SpeechToTextLinuxPluginState* state,
+                             const RecognitionSession* session) {
+  std::lock_guard<std::mutex> lock(state->stats.mutex);
+  switch (session->session_end) {
+    case SessionEnd::kAcousticEndpoint:
+      state->stats.acoustic_endpoints++;
+      break;
+    case SessionEnd::kVoskEndpoint:
+      state->stats.vosk_endpoints++;
+      break;
+    case SessionEnd::kPauseTimeout:
+      state->stats.pause_timeouts++;
+      break;
+    case SessionEnd::kListenTimeout:
+      state->stats.listen_timeouts++;
+      return;
+    default:
+      return;
+  }
+  if (session->reported_speech && session->endpointer.heard_speech()) {
+    const std::chrono::duration<double, std::milli> latency =
+        std::chrono::steady_clock::now() - session->speech_ended_at;
+    state->stats.end_of_speech_to_final.Record(latency.count());
+  }
+}
+
+PooledRecognizer TakePooledRecognizerLocked(SpeechToTextLinuxPluginState* state,
+                                            int sample_rate) {
+  for (auto it = state->recognizer_pool.begin(); it != state->recognizer_pool.end(); ++it) {
+    if (it->sample_rate == sample_rate) {
+      const PooledRecognizer pooled = *it;
+      state->recognizer_pool.erase(it);
+      return pooled;
+    }
+  }
+  return PooledRecognizer{nullptr, sample_rate, 0};
+}
+
+// Returns a finished session's recognizer to the pool when it can be reused,
+// and frees it otherwise.
+static void RecycleRecognizer(SpeechToTextLinuxPluginState* state, RecognitionSession* session) {
+  VoskRecognizer* recognizer = session->recognizer;
+  session->recognizer = nullptr;
+  if (recognizer == nullptr) {
+    return;
+  }
+  if (session->poolable) {
+    state->vosk.Reset(recognizer);
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (session->model == state->model &&
+        state->recognizer_pool.size() < kMaxPooledRecognizers) {
+      state->recognizer_pool.push_back(
+          PooledRecognizer{recognizer, session->sample_rate, session->clock.fed});
+      return;
+    }
+  }
+  state->vosk.FreeRecognizer(recognizer);
+}
+
+// The session's last step: from here on nothing touches it, and the
+// plugin's teardown may stop waiting for it.
+static void MarkSessionIdle(SpeechToTextLinuxPluginState* state, RecognitionSession* session) {
+  {
+    std::lock_guard<std::mutex> lock(state->idle_mutex);
+    session->phase.store(SessionPhase::kIdle);
+  }
+  state->idle_changed.notify_all();
+}
+
+void DiscardPendingRecognizer(RecognitionSession* session) {
+  if (session->pending_recognizer.valid()) {
+    session->vosk->FreeRecognizer(session->pending_recognizer.get().recognizer);
+  }
+  for (const auto& lane : session->lanes) {
+    if (lane->pending_recognizer.valid()) {
+      lane->recognizer = lane->pending_recognizer.get();
+    }
+    session->vosk->FreeRecognizer(lane->recognizer);
+    lane->recognizer = nullptr;
+  }
+  SecondPass* pass = session->second_pass.get();
+  if (pass != nullptr) {
+    if (pass->pending_recognizer.valid()) {
+      pass->recognizer = pass->pending_recognizer.get();
+    }
+    session->vosk->FreeRecognizer(pass->recognizer);
+    pass->recognizer = nullptr;
+  }
+}
+
+void AbandonStartingSession(SpeechToTextLinuxPluginState* state,
+                            RecognitionSession* session) {
+  DiscardPendingRecognizer(session);
+  MarkSessionIdle(state, session);
+}
+
+static void RecordFirstResult(SpeechToTextLinuxPluginState* state, RecognitionSession* session) {
+  if (session->first_result_recorded) {
+    return;
+  }
+  session->first_result_recorded = true;
+  const std::chrono::duration<double, std::milli> latency =
+      std::chrono::steady_clock::now() - session->tapped_at;
+  std::lock_guard<std::mutex> lock(state->stats.mutex);
+  state->stats.tap_to_first_result[static_cast<int>(session->start_mode)].Record(latency.count());
+}
+
+// Maps stream positions [first, end) of |session| onto CLOCK_MONOTONIC.
+static AudioSpan StreamSpan(const RecognitionSession* session, int64_t first, int64_t end) {
+  AudioSpan span;
+  const int64_t origin_ns = session->stream_origin_ns.load(std::memory_order_acquire);
+  if (origin_ns == 0 || first < 0 || end <= first) {
+    return span;
+  }
+  const double origin_ms = static_cast<double>(origin_ns) / 1e6;
+  const double ms_per_sample = 1000.0 / session->sample_rate;
+  span.start_ms = origin_ms + static_cast<double>(first) * ms_per_sample;
+  span.end_ms = origin_ms + static_cast<double>(end - 1) * ms_per_sample;
+  return span;
+}
+
+// CLOCK_MONOTONIC milliseconds of |seconds| on the session's timeline,
+// which starts at the stream's first sample; -1 while that is unknown.
+static double SessionMillis(const RecognitionSession* session, double seconds) {
+  const int64_t origin_ns = session->stream_origin_ns.load(std::memory_order_acquire);
+  if (origin_ns == 0 || seconds < 0.0) {
+    return -1.0;
+  }
+  return static_cast<double>(origin_ns) / 1e6 + seconds * 1000.0;
+}
+
+bool ExtractSessionWords(const RecognitionSession* session, const RecognizerClock& clock,
+                         const char* json, double result_conf,
+                         std::vector<WordTiming>* words) {
+  if (!ExtractWordTimings(json, words)) {
+    return false;
+  }
+  const double rate = static_cast<double>(session->sample_rate);
+  for (WordTiming& word : *words) {
+    word.start = clock.ToStream(word.start, session->sample_rate) / rate;
+    word.end = clock.ToStream(word.end, session->sample_rate) / rate;
+    if (word.conf < 0.0) {
+      word.conf = result_conf;
+    }
+  }
+  return true;
+}
+
+// Records the span fed to a recognizer whose utterance is tracked by
+// |start| and |end|.
+static void TrackUtterance(int64_t* start, int64_t* end, int64_t first, int64_t frames) {
+  if (*start < 0) {
+    *start = first;
+  }
+  *end = first + frames;
+}
+
+// How often the capture callback re-anchors a session's stream clock.
+constexpr int64_t kStreamAnchorSeconds = 10;
+
+// Anchors the stream clock on the buffer that starts at stream |position|:
+// its ADC time is PortAudio stream time, which only relates to
+// CLOCK_MONOTONIC through the callback's own `currentTime`. Host APIs that
+// report no ADC time get the buffer's length instead, which only serves to
+// place the first buffer. Later anchors move the origin a quarter of the way
+// to the new estimate, which follows the device clock's drift without
+// passing every anchor's jitter on to timestamps.
+static void AnchorStreamClock(RecognitionSession* session,
+                              const PaStreamCallbackTimeInfo* time_info,
+                              unsigned long frame_count, int64_t position) {
+  const int64_t current_ns = session->stream_origin_ns.load(std::memory_order_relaxed);
+  double age = static_cast<double>(frame_count) / session->sample_rate;
+  if (time_info != nullptr && time_info->inputBufferAdcTime > 0.0 &&
+      time_info->currentTime >= time_info->inputBufferAdcTime &&
+      time_info->currentTime - time_info->inputBufferAdcTime < 1.0) {
+    age = time_info->currentTime - time_info->inputBufferAdcTime;
+  } else if (current_ns != 0) {
+    return;
+  }
+  const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now().time_since_epoch())
+                             .count();
+  const int64_t origin_ns =
+      now_ns - static_cast<int64_t>((age + static_cast<double>(position) / session->sample_rate) *
+                                    1e9);
+  const int64_t anchored_ns =
+      current_ns == 0 ? origin_ns : current_ns + (origin_ns - current_ns) / 4;
+  session->stream_origin_ns.store(std::max<int64_t>(anchored_ns, 1), std::memory_order_release);
+}
+
+int CaptureCallback(const void* input, void* output, unsigned long frame_count,
+                    const PaStreamCallbackTimeInfo* time_info,
+                    PaStreamCallbackFlags status_flags, void* user_data) {
+  auto* session = static_cast<RecognitionSession*>(user_data);
+  const int64_t position = session->stream_captured;
+  session->stream_captured += static_cast<int64_t>(frame_count);
+  if (position >= session->next_anchor) {
+    AnchorStreamClock(session, time_info, frame_count, position);
+    session->next_anchor = position + kStreamAnchorSeconds * session->sample_rate;
+  }
+  if (input != nullptr && session->ring != nullptr) {
+    session->ring->Write(static_cast<const int16_t*>(input), frame_count);
+  }
+  session->waker.Notify();
+  return paContinue;
+}
+
+// Queues one final the app was sent for the session's transcript journal.
+// |words| are on the session's timeline and written, like every other time
+// in the line, as CLOCK_MONOTONIC milliseconds. |end_of_speech_ms| is left
+// out of the line when negative.
+static void JournalFinal(RecognitionSession* session, const std::string& recognizer,
+                         const std::string& text, double confidence,
+                         const std::vector<WordTiming>& words, const AudioSpan& span,
+                         bool second_pass, double end_of_speech_ms) {
+  if (session->journal == nullptr) {
+    return;
+  }
+  const auto wall_now = std::chrono::system_clock::now();
+  const auto steady_now = std::chrono::steady_clock::now();
+
+  std::string line;
+  line.reserve(256 + words.size() * 64);
+  char number[96];
+  line.push_back('{');
+  AppendSessionIds(&line, session->id, session->handle_id);
+  line.append(",\"recognizer\":\"");
+  AppendEscapedJson(&line, recognizer);
+  line.append(second_pass ? "\",\"secondPass\":true,\"text\":\"" : "\",\"text\":\"");
+  AppendEscapedJson(&line, text);
+  line.append("\",\"words\":[");
+  for (size_t i = 0; i < words.size(); ++i) {
+    const WordTiming& word = words[i];
+    line.append(i > 0 ? ",{\"word\":\"" : "{\"word\":\"");
+    AppendEscapedJson(&line, word.word);
+    line.append("\",\"startMillis\":");
+    AppendFixed(&line, SessionMillis(session, word.start), 1);
+    line.append(",\"endMillis\":");
+    AppendFixed(&line, SessionMillis(session, word.end), 1);
+    line.append(",\"conf\":");
+    AppendFixed(&line, word.conf, 3);
+    line.push_back('}');
+  }
+  line.append("],\"confidence\":");
+  AppendFixed(&line, confidence, 3);
+  if (span.known()) {
+    line.append(",\"audioStartMillis\":");
+    AppendFixed(&line, span.start_ms, 1);
+    line.append(",\"audioEndMillis\":");
+    AppendFixed(&line, span.end_ms, 1);
+  }
+
+  // Wall clock as UTC ISO 8601; the monotonic clock lines up with `stats`
+  // and the audio times.
+  const time_t wall_seconds = std::chrono::system_clock::to_time_t(wall_now);
+  const int64_t wall_millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                  wall_now.time_since_epoch()).count() % 1000;
+  struct tm utc;
+  gmtime_r(&wall_seconds, &utc);
+  char stamp[32];
+  strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+  snprintf(number, sizeof(number), ",\"wallClock\":\"%s.%03lldZ\",\"monotonicMillis\":", stamp,
+           static_cast<long long>(wall_millis));
+  line.append(number);
+  const std::chrono::duration<double, std::milli> monotonic = steady_now.time_since_epoch();
+  AppendFixed(&line, monotonic.count(), 3);
+
+  const std::chrono::duration<double, std::milli> since_listen = steady_now - session->tapped_at;
+  line.append(",\"latency\":{\"sinceListenMillis\":");
+  AppendFixed(&line, since_listen.count(), 1);
+  if (end_of_speech_ms >= 0.0) {
+    line.append(",\"endOfSpeechToFinalMillis\":");
+    AppendFixed(&line, end_of_speech_ms, 1);
+  }
+  line.append("}}");
+  session->journal->Append(std::move(line));
+}
+
+static thread_local std::vector<WordTiming> tls_session_words;
+
+// True when the session sends or journals the words of its finals.
+static bool WantsWords(const RecognitionSession* session) {
+  return session->word_timings || session->journal != nullptr;
+}
+
+// Follows a final of the recognizer behind |clock| that the app was just
+// sent with its word timings, and journals it.
+static void SendWordsAndJournal(PluginCore* self, RecognitionSession* session,
+                                const std::string& recognizer, const RecognizerClock& clock,
+                                const char* json, const std::string& text, double confidence,
+                                const AudioSpan& span, bool second_pass,
+                                double end_of_speech_ms) {
+  if (!WantsWords(session)) {
+    return;
+  }
+  ExtractSessionWords(session, clock, json, confidence, &tls_session_words);
+  SendWordTimings(self, session, recognizer, tls_session_words);
+  JournalFinal(session, recognizer, text, confidence, tls_session_words, span, second_pass,
+               end_of_speech_ms);
+}
+
+// Time from the end of the session's last speech to now, or -1 without
+// speech.
+static double SinceSpeechEnded(const RecognitionSession* session) {
+  if (!session->endpointer.heard_speech()) {
+    return -1.0;
+  }
+  const std::chrono::duration<double, std::milli> since_speech =
+      std::chrono::steady_clock::now() - session->speech_ended_at;
+  return since_speech.count();
+}
+
+static void ScheduleLane(PluginCore* self, RecognitionSession* session,
+                         RecognizerLane* lane);
+
+// Sends the held finals of the picked candidate as one result.
+static void ReleaseRaceWinnerLocked(PluginCore* self, RecognitionSession* session,
+                                    LanguageRace& race) {
+  RaceCandidate& winner = race.candidates[race.winner];
+  std::string event("{");
+  AppendSessionIds(&event, session->id, session->handle_id);
+  event.append(",\"status\":\"recognizerSelected\",\"recognizer\":\"");
+  AppendEscapedJson(&event, winner.name);
+  event.append("\"}");
+  InvokeStringOnMain(self, "sessionStatus", event);
+  if (!winner.held_text.empty()) {
+    SendRecognitionAs(self, session, winner.name, winner.held_text, winner.score(), true,
+                      winner.held_span);
+    SendWordTimings(self, session, winner.name, winner.held_words);
+    JournalFinal(session, winner.name, winner.held_text, winner.score(), winner.held_words,
+                 winner.held_span, false, -1.0);
+    winner.held_text.clear();
+    winner.held_span = AudioSpan();
+    winner.held_words.clear();
+  }
+  std::lock_guard<std::mutex> lock(self->state->stats.mutex);
+  self->state->stats.language_picks++;
+}
+
+// Re-ranks the candidates, drops the clear losers and, once a single one is
+// left, declares it the winner. Lanes that lost are returned to be woken.
+static void UpdateRaceLocked(PluginCore* self, RecognitionSession* session,
+                             LanguageRace& race, std::vector<RecognizerLane*>* dropped_lanes) {
+  double best = -1.0;
+  for (size_t i = 0; i < race.candidates.size(); ++i) {
+    const RaceCandidate& candidate = race.candidates[i];
+    if (!candidate.dropped && candidate.words > 0 && candidate.score() > best) {
+      best = candidate.score();
+      race.leader = static_cast<int>(i);
+    }
+  }
+  const RaceCandidate& leader = race.candidates[race.leader];
+  int remaining = 0;
+  for (size_t i = 0; i < race.candidates.size(); ++i) {
+    RaceCandidate& candidate = race.candidates[i];
+    if (!candidate.dropped && static_cast<int>(i) != race.leader &&
+        leader.words >= race.min_words && candidate.words > 0 &&
+        leader.score() - candidate.score() >= race.margin) {
+      candidate.dropped = true;
+      candidate.held_text.clear();
+      if (i == 0) {
+        // A continuous session's own recognizer marks the segment
+        // boundaries the race reopens at, so it keeps decoding.
+        session->dropped.store(!session->continuous);
+      } else {
+        RecognizerLane* lane = session->lanes[i - 1].get();
+        lane->dropped.store(true);
+        dropped_lanes->push_back(lane);
+      }
+      std::lock_guard<std::mutex> lock(self->state->stats.mutex);
+      self->state->stats.early_drops++;
+    }
+    remaining += candidate.dropped ? 0 : 1;
+  }
+  if (remaining == 1 && race.winner < 0) {
+    race.winner = race.leader;
+    ReleaseRaceWinnerLocked(self, session, race);
+  }
+}
+
+// Routes a result of race candidate |index|, whose recognizer runs on
+// |clock|, while the session picks a recognizer. Only finals the app is
+// sent are journaled.
+static void DeliverRaceResult(PluginCore* self, RecognitionSession* session,
+                              int index, const RecognizerClock& clock, const std::string& json,
+                              const std::string& text, bool final_result,
+                              const AudioSpan& span) {
+  LanguageRace& race = *session->race;
+  std::vector<RecognizerLane*> dropped_lanes;
+  {
+    std::lock_guard<std::mutex> lock(race.mutex);
+    RaceCandidate& candidate = race.candidates[index];
+    if (final_result && span.known() && span.start_ms < race.opened_ms) {
+      // Began before the race reopened: only the previous pick is shown.
+      if (index == race.previous_winner) {
+        int words = 0;
+        const double sum = ExtractConfidenceSum(json, &words);
+        const double confidence = words > 0 ? sum / words : -1.0;
+        SendRecognitionAs(self, session, candidate.name, text, confidence, true, span);
+        SendWordsAndJournal(self, session, candidate.name, clock, json.c_str(), text,
+                            confidence, span, false, -1.0);
+      }
+      return;
+    }
+    if (candidate.dropped) {
+      return;
+    }
+    if (!final_result) {
+      if (race.winner == index || (race.winner < 0 && race.leader == index)) {
+        SendRecognitionAs(self, session, candidate.name, text, -1.0, false, span);
+      }
+      return;
+    }
+    int words = 0;
+    const double sum = ExtractConfidenceSum(json, &words);
+    if (race.winner == index) {
+      const double confidence = words > 0 ? sum / words : -1.0;
+      SendRecognitionAs(self, session, candidate.name, text, confidence, true, span);
+      SendWordsAndJournal(self, session, candidate.name, clock, json.c_str(), text, confidence,
+                          span, false, -1.0);
+      return;
+    }
+    candidate.words += words;
+    candidate.confidence_sum += sum;
+    candidate.held_text += candidate.held_text.empty() ? text : " " + text;
+    candidate.held_span.Extend(span);
+    if (WantsWords(session) && ExtractSessionWords(session, clock, json.c_str(),
+                                                   words > 0 ? sum / words : -1.0,
+                                                   &tls_session_words)) {
+      candidate.held_words.insert(candidate.held_words.end(), tls_session_words.begin(),
+                                  tls_session_words.end());
+    }
+    if (race.winner < 0) {
+      UpdateRaceLocked(self, session, race, &dropped_lanes);
+    }
+  }
+  for (RecognizerLane* lane : dropped_lanes) {
+    ScheduleLane(self, session, lane);
+  }
+}
+
+// Settles the current utterance's pick, if no candidate pulled clear yet,
+// and starts a new race at stream position |boundary|. Lanes that lost
+// start over from there.
+static void ReopenRace(PluginCore* self, RecognitionSession* session,
+                       int64_t boundary) {
+  LanguageRace& race = *session->race;
+  std::lock_guard<std::mutex> lock(race.mutex);
+  if (race.winner < 0) {
+    race.winner = race.leader;
+    ReleaseRaceWinnerLocked(self, session, race);
+  }
+  race.previous_winner = race.winner;
+  race.opened_ms = StreamSpan(session, boundary, boundary + 1).start_ms;
+  for (RaceCandidate& candidate : race.candidates) {
+    candidate.words = 0;
+    candidate.confidence_sum = 0.0;
+    candidate.held_text.clear();
+    candidate.held_span = AudioSpan();
+    candidate.held_words.clear();
+    candidate.dropped = false;
+  }
+  for (const auto& lane : session->lanes) {
+    if (lane->dropped.exchange(false)) {
+      lane->reset_pending.store(true);
+    }
+  }
+  // Until the new race ranks anyone, show the previous pick's partials.
+  race.leader = race.winner;
+  race.winner = -1;
+}
+
+static void RunSecondPassTask(PluginCore* self, RecognitionSession* session);
+
+// Hands the segment that just ended to the second pass. When its queue is
+// full the first-pass final is sent right away instead.
+static void QueueSecondPass(PluginCore* self, RecognitionSession* session,
+                            const std::string& json, const std::string& text,
+                            const AudioSpan& span) {
+  SecondPass& pass = *session->second_pass;
+  SecondPassJob job;
+  job.chunks.swap(session->segment);
+  job.fallback_text = text;
+  job.fallback_confidence = ExtractAverageConfidence(json);
+  if (WantsWords(session)) {
+    // Mapped now: the session's clock moves on while the job waits.
+    ExtractSessionWords(session, session->clock, json.c_str(), job.fallback_confidence,
+                        &job.fallback_words);
+    if (session->endpointer.heard_speech()) {
+      job.speech_ended_at = session->speech_ended_at;
+    }
+  }
+  job.span = span;
+  job.overflowed = session->segment_overflowed;
+  job.queued_at = std::chrono::steady_clock::now();
+  job.deadline = job.queued_at + pass.budget;
+  session->segment_samples = 0;
+  session->segment_overflowed = false;
+
+  bool queued = false;
+  bool submit = false;
+  {
+    std::lock_guard<std::mutex> lock(pass.mutex);
+    job.fallback_only =
+        job.overflowed || pass.recognizer == nullptr || pass.audio_jobs >= pass.max_queue;
+    // Nothing queued ahead: a fallback can go out right away.
+    if (!job.fallback_only || pass.scheduled) {
+      if (job.fallback_only) {
+        job.chunks.clear();
+      } else {
+        pass.audio_jobs++;
+      }
+      // The job keeps the session open until its final is out. The caller's
+      // own slot is still held, so the count cannot have reached zero.
+      session->open_recognizers.fetch_add(1);
+      pass.jobs.push_back(std::move(job));
+      queued = true;
+      submit = !pass.scheduled;
+      pass.scheduled = true;
+    }
+  }
+  if (submit) {
+    self->state->scheduler->Submit([self, session] { RunSecondPassTask(self, session); });
+  }
+  if (!queued) {
+    SendRecognition(self, session, job.fallback_text, job.fallback_confidence, true, job.span);
+    SendWordTimings(self, session, session->recognizer_name, job.fallback_words);
+    JournalFinal(session, session->recognizer_name, job.fallback_text, job.fallback_confidence,
+                 job.fallback_words, job.span, false, SinceSpeechEnded(session));
+    std::lock_guard<std::mutex> lock(self->state->stats.mutex);
+    self->state->stats.second_pass_fallbacks++;
+  }
+}
+
+// Sends a result of the session's own recognizer, through the race if the
+// session is picking between recognizers, or via the second pass.
+static void DeliverResult(PluginCore* self, RecognitionSession* session,
+                          const char* json, const std::string& text, bool final_result) {
+  const AudioSpan span = StreamSpan(session, session->utterance_start, session->utterance_end);
+  if (final_result && session->second_pass != nullptr) {
+    QueueSecondPass(self, session, json, text, span);
+  } else if (session->race != nullptr) {
+    DeliverRaceResult(self, session, 0, session->clock, json, text, final_result, span);
+  } else if (final_result && session->max_alternatives > 0 &&
+             ExtractAlternatives(json, &tls_alternatives)) {
+    const double confidence = tls_alternatives.front().confidence;
+    SendRecognitionAs(self, session, session->recognizer_name, text, confidence, true, span,
+                      &tls_alternatives);
+    SendWordsAndJournal(self, session, session->recognizer_name, session->clock, json, text,
+                        confidence, span, false, SinceSpeechEnded(session));
+  } else {
+    const double confidence = final_result ? ExtractAverageConfidence(json) : -1.0;
+    SendRecognition(self, session, text, confidence, final_result, span);
+    if (final_result) {
+      SendWordsAndJournal(self, session, session->recognizer_name, session->clock, json, text,
+                          confidence, span, false, SinceSpeechEnded(session));
+    }
+  }
+}
+
+// Swaps in the recognizer that matches the adaptive level. Only called at a
+// segment boundary, where the outgoing recognizer holds no pending audio.
+static void SwitchModelAtBoundary(PluginCore* self, RecognitionSession* session) {
+  AdaptiveDecoding* adaptive = session->adaptive.get();
+  if (adaptive == nullptr || adaptive->use_light == (adaptive->level >= 2)) {
+    return;
+  }
+  const VoskApi& vosk = *session->vosk;
+  if (adaptive->spare == nullptr) {
+    adaptive->spare = CreateRecognizer(&vosk, adaptive->light_model, adaptive->options).recognizer;
+    if (adaptive->spare == nullptr) {
+      SendSessionError(self, session, "Failed to create Vosk recognizer for the light model",
+                       false);
+      adaptive->light_model = nullptr;
+      adaptive->level = 1;
+      session->decode_level.store(1);
+      return;
+    }
+  } else {
+    vosk.Reset(adaptive->spare);
+  }
+  std::swap(session->recognizer, adaptive->spare);
+  std::swap(session->clock, adaptive->spare_clock);
+  adaptive->use_light = !adaptive->use_light;
+  vosk.EnablePartialWords(session->recognizer,
+                          adaptive->level == 0 && session->partial_results_enabled);
+  session->last_partial_text.clear();
+}
+
+// Folds one decode slice into the session's real-time factor and, with
+// adaptive decoding, steps the level once the pressure has held long enough.
+static void TrackRealTimeFactor(PluginCore* self, RecognitionSession* session,
+                                double elapsed_seconds, size_t frames) {
+  if (frames == 0) {
+    return;
+  }
+  const double sample =
+      elapsed_seconds * session->sample_rate / static_cast<double>(frames);
+  const double previous = session->real_time_factor.load();
+  const double rtf = previous == 0.0 ? sample : 0.8 * previous + 0.2 * sample;
+  session->real_time_factor.store(rtf);
+  AdaptiveDecoding* adaptive = session->adaptive.get();
+  if (adaptive == nullptr) {
+    return;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  const int pressure = rtf > adaptive->rtf_high ? 1 : (rtf < adaptive->rtf_low ? -1 : 0);
+  if (pressure != adaptive->pressure) {
+    adaptive->pressure = pressure;
+    adaptive->pressure_since = now;
+    return;
+  }
+  const int level = adaptive->level + pressure;
+  if (pressure == 0 || now - adaptive->pressure_since < adaptive->hold || level < 0 ||
+      level > adaptive->max_level()) {
+    return;
+  }
+  // Every further step needs the pressure to hold again.
+  adaptive->level = level;
+  adaptive->pressure_since = now;
+  session->decode_level.store(level);
+  if (level <= 1 && session->recognizer != nullptr && !adaptive->use_light) {
+    session->vosk->EnablePartialWords(session->recognizer,
+                                      level == 0 && session->partial_results_enabled);
+  }
+  DebugLog(self, std::string(pressure > 0 ? "Decoding downgraded" : "Decoding restored") +
+                     " to level " + std::to_string(level));
+  SendSessionStatus(self, session, pressure > 0 ? "downgraded" : "restored");
+  std::lock_guard<std::mutex> lock(self->state->stats.mutex);
+  (pressure > 0 ? self->state->stats.downgrades : self->state->stats.restores)++;
+}
+
+void EndSegment(PluginCore* self, RecognitionSession* session,
+                std::string json) {
+  const VoskApi& vosk = *session->vosk;
+  if (json.empty()) {
+    json = vosk.FinalResult(session->recognizer);
+  }
+  const std::string text = ExtractJsonText(json, "text");
+  if (!text.empty()) {
+    session->reported_speech = true;
+    session->last_speech_at = std::chrono::steady_clock::now();
+    DeliverResult(self, session, json.c_str(), text, true);
+    RecordFirstResult(self->state, session);
+  }
+  vosk.Reset(session->recognizer);
+  session->last_partial_text.clear();
+  session->utterance_start = -1;
+  session->segments++;
+  if (session->race != nullptr) {
+    ReopenRace(self, session, session->stream_read);
+  }
+  SwitchModelAtBoundary(self, session);
+  std::lock_guard<std::mutex> lock(self->state->stats.mutex);
+  self->state->stats.continuous_segments++;
+}
+
+static void PublishChunk(PluginCore* self, RecognitionSession* session,
+                         const AudioChunkRef& chunk);
+
+// Hands one chunk to the session's own recognizer and delivers what it
+// recognized. Returns false when the Vosk endpointer ended the session.
+static bool DecodeAudio(PluginCore* self, RecognitionSession* session,
+                        const int16_t* data, int frames, const AudioChunkRef& chunk) {
+  SpeechToTextLinuxPluginState* state = self->state;
+  const VoskApi& vosk = *session->vosk;
+  if (session->utterance_start < 0 && session->grammar_changed.load() &&
+      session->grammar_changed.exchange(false)) {
+    // Nothing decoded since the last final or reset, so no words are cut.
+    std::string grammar;
+    {
+      std::lock_guard<std::mutex> lock(session->grammar_mutex);
+      grammar.swap(session->pending_grammar);
+    }
+    vosk.SetGrammar(session->recognizer, grammar);
+    // The grammar sticks to the recognizer, so it must not be pooled.
+    session->poolable = false;
+  }
+  session->decoded_samples += frames;
+  TrackUtterance(&session->utterance_start, &session->utterance_end,
+                 session->stream_read - frames, frames);
+  if (session->second_pass != nullptr && !session->segment_overflowed) {
+    session->segment.push_back(chunk);
+    session->segment_samples += frames;
+    if (session->segment_samples >
+        static_cast<int64_t>(session->sample_rate) * kMaxSecondPassSegmentSeconds) {
+      session->segment.clear();
+      session->segment_overflowed = true;
+    }
+  }
+  if (session->dropped.load()) {
+    // Lost the language pick; only endpointing and deadlines still matter.
+    return true;
+  }
+  session->clock.Feed(session->stream_read - frames, frames);
+  const int accepted = vosk.AcceptWaveform(session->recognizer, data, frames);
+  if (accepted != 0 && session->continuous) {
+    EndSegment(self, session, vosk.Result(session->recognizer));
+  } else if (accepted != 0) {
+    const std::string json = vosk.Result(session->recognizer);
+    const std::string text = ExtractJsonText(json, "text");
+    if (!text.empty()) {
+      session->reported_speech = true;
+      session->last_speech_at = std::chrono::steady_clock::now();
+      DeliverResult(self, session, json.c_str(), text, true);
+      RecordFirstResult(state, session);
+      if (session->endpoint_on_vosk_result) {
+        session->session_end = SessionEnd::kVoskEndpoint;
+        return false;
+      }
+    }
+    session->utterance_start = -1;
+    SwitchModelAtBoundary(self, session);
+  } else if (session->partial_results_enabled && !session->catching_up) {
+    // Polled every chunk: an unchanged partial must not allocate.
+    const char* json = vosk.PartialResult(session->recognizer);
+    std::string& text = session->partial_scratch;
+    if (ExtractJsonTextTo(json, "partial", &text) && text != session->last_partial_text) {
+      session->reported_speech = true;
+      session->last_partial_text.assign(text);
+      session->last_speech_at = std::chrono::steady_clock::now();
+      DeliverResult(self, session, json, text, false);
+      RecordFirstResult(state, session);
+    }
+  }
+  return true;
+}
+
+// True when |phrase| occurs in |text| as whole words.
+static bool ContainsPhrase(const std::string& text, const std::string& phrase) {
+  for (size_t pos = text.find(phrase); pos != std::string::npos;
+       pos = text.find(phrase, pos + 1)) {
+    const size_t end = pos + phrase.size();
+    if ((pos == 0 || text[pos - 1] == ' ') && (end == text.size() || text[end] == ' ')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Feeds the keyword spotter and returns whether it heard a keyword.
+static bool FeedSpotter(const VoskApi& vosk, KeywordStandby& standby, const int16_t* data,
+                        size_t frames) {
+  standby.gated_samples += static_cast<int64_t>(frames);
+  const bool accepted =
+      vosk.AcceptWaveform(standby.spotter, data, static_cast<int>(frames)) != 0;
+  std::string& text = standby.scratch;
+  if (accepted) {
+    ExtractJsonTextTo(vosk.Result(standby.spotter).c_str(), "text", &text);
+  } else {
+    ExtractJsonTextTo(vosk.PartialResult(standby.spotter), "partial", &text);
+  }
+  for (const auto& keyword : standby.keywords) {
+    if (ContainsPhrase(text, keyword)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void RecordStandbyStats(SpeechToTextLinuxPluginState* state, RecognitionSession* session,
+                               bool detected) {
+  const KeywordStandby& standby = *session->standby;
+  std::lock_guard<std::mutex> lock(state->stats.mutex);
+  state->stats.standby_detections += detected ? 1 : 0;
+  state->stats.standby_audio_seconds +=
+      static_cast<double>(standby.heard_samples) / session->sample_rate;
+  state->stats.standby_decoded_seconds +=
+      static_cast<double>(standby.gated_samples) / session->sample_rate;
+  state->stats.standby_cpu_seconds += standby.cpu_seconds;
+}
+
+// Leaves standby: the pre-roll, which holds the keyword, goes through the
+// regular pipeline and the session carries on as a normal one.
+static bool WakeFromStandby(PluginCore* self, RecognitionSession* session) {
+  KeywordStandby& standby = *session->standby;
+  session->vosk->FreeRecognizer(standby.spotter);
+  standby.spotter = nullptr;
+  RecordStandbyStats(self->state, session, true);
+  auto pre_roll = std::make_shared<AudioChunk>();
+  pre_roll->samples = standby.Recent(standby.pre_roll.size());
+  pre_roll->captured_at = std::chrono::steady_clock::now();
+  // The pre-roll ends with the chunk just read.
+  pre_roll->first_sample =
+      session->stream_read - static_cast<int64_t>(pre_roll->samples.size());
+  session->listen_timeout = standby.listen_timeout;
+  session->listen_started = pre_roll->captured_at;
+  session->last_speech_at = pre_roll->captured_at;
+  session->standby.reset();
+  SendSessionStatus(self, session, "wakeWord");
+  if (pre_roll->samples.empty()) {
+    return true;
+  }
+  PublishChunk(self, session, pre_roll);
+  return DecodeAudio(self, session, pre_roll->samples.data(),
+                     static_cast<int>(pre_roll->samples.size()), pre_roll);
+}
+
+// Standby step: remembers the chunk and runs the spotter while the energy
+// endpointer hears voice, plus a short hangover.
+static bool ProcessStandby(PluginCore* self, RecognitionSession* session,
+                           const int16_t* data, int frames) {
+  KeywordStandby& standby = *session->standby;
+  const VoskApi& vosk = *session->vosk;
+  standby.Remember(data, static_cast<size_t>(frames));
+  standby.heard_samples += frames;
+  const int64_t hangover =
+      static_cast<int64_t>(session->sample_rate) * kStandbyHangoverMillis / 1000;
+  const bool voiced = session->endpointer.heard_speech() &&
+                      session->endpointer.samples_since_voice() < hangover;
+  if (!voiced) {
+    if (standby.gate_open && standby.spotter != nullptr) {
+      vosk.Reset(standby.spotter);
+    }
+    standby.gate_open = false;
+    return true;
+  }
+  const double cpu_started = ThreadCpuSeconds();
+  if (standby.spotter == nullptr) {
+    standby.spotter = vosk.NewGrammarRecognizer(
+        session->model, static_cast<float>(session->sample_rate), standby.grammar);
+    if (standby.spotter == nullptr) {
+      SendSessionError(self, session, "Failed to create Vosk keyword recognizer", true);
+      session->session_end = SessionEnd::kStreamError;
+      return false;
+    }
+  }
+  bool detected = false;
+  if (standby.gate_open) {
+    detected = FeedSpotter(vosk, standby, data, static_cast<size_t>(frames));
+  } else {
+    // The endpointer needs a few voiced frames to decide, so replay the
+    // onset it has already seen.
+    standby.gate_open = true;
+    const std::vector<int16_t> onset = standby.Recent(
+        static_cast<size_t>(frames) +
+        static_cast<size_t>(session->sample_rate) * kStandbyLookbackMillis / 1000);
+    detected = FeedSpotter(vosk, standby, onset.data(), onset.size());
+  }
+  standby.cpu_seconds += ThreadCpuSeconds() - cpu_started;
+  return detected ? WakeFromStandby(self, session) : true;
+}
+
+// Feeds one chunk of captured audio through the endpointer and recognizer.
+// Returns false when the chunk ended the session.
+static bool ProcessAudio(PluginCore* self, RecognitionSession* session,
+                         const int16_t* data, int frames, const AudioChunkRef& chunk,
+                         std::chrono::steady_clock::time_point captured_at) {
+  SendSoundLevel(self, session, ComputeSoundLevel(data, frames));
+  const auto endpoint_event = session->endpointer.Process(data, frames);
+  if (session->endpointer.heard_speech()) {
+    // Backdate to the last voiced frame inside the chunk.
+    session->speech_ended_at =
+        captured_at - std::chrono::microseconds(session->endpointer.samples_since_voice() *
+                                                1000000 / session->sample_rate);
+  }
+  if (session->standby != nullptr) {
+    return ProcessStandby(self, session, data, frames);
+  }
+  const int64_t keep_silence =
+      static_cast<int64_t>(session->sample_rate) * kCatchUpKeepSilenceMillis / 1000;
+  if (session->catching_up && session->drop_silence_when_behind &&
+      session->endpointer.samples_since_voice() >= frames + keep_silence) {
+    session->skipped_samples += frames;
+  } else if (!DecodeAudio(self, session, data, frames, chunk)) {
+    return false;
+  }
+  if (session->endpoint_enabled && endpoint_event == EnergyEndpointer::Event::kEndOfSpeech) {
+    if (!session->continuous) {
+      session->session_end = SessionEnd::kAcousticEndpoint;
+      return false;
+    }
+    if (!session->dropped.load()) {
+      EndSegment(self, session, std::string());
+    }
+  }
+  return true;
+}
+
+// Returns false once the listen or pause deadline has passed.
+static bool CheckDeadlines(RecognitionSession* session,
+                           std::chrono::steady_clock::time_point now) {
+  if (session->listen_timeout.count() > 0 &&
+      now - session->listen_started >= session->listen_timeout) {
+    session->session_end = SessionEnd::kListenTimeout;
+    return false;
+  }
+  if (session->pause_timeout.count() > 0 && session->reported_speech &&
+      now - session->last_speech_at >= session->pause_timeout) {
+    session->session_end = SessionEnd::kPauseTimeout;
+    return false;
+  }
+  return true;
+}
+
+static void ArmNextDeadline(RecognitionSession* session) {
+  bool armed = false;
+  std::chrono::steady_clock::time_point deadline;
+  if (session->listen_timeout.count() > 0) {
+    deadline = session->listen_started + session->listen_timeout;
+    armed = true;
+  }
+  if (session->pause_timeout.count() > 0 && session->reported_speech) {
+    const auto pause_deadline = session->last_speech_at + session->pause_timeout;
+    deadline = armed ? std::min(deadline, pause_deadline) : pause_deadline;
+    armed = true;
+  }
+  if (armed) {
+    session->waker.ArmDeadline(deadline);
+  } else {
+    session->waker.DisarmDeadline();
+  }
+}
+
+// Audio decoded per task before the session yields its worker, so one busy
+// stream cannot starve the others sharing the pool.
+constexpr int kDecodeSliceMillis = 200;
+
+// Samples the ring depth at the start of a slice and moves the session in
+// or out of catch-up mode.
+static void UpdateCatchUp(PluginCore* self, RecognitionSession* session) {
+  const size_t backlog = session->ring->Available();
+  session->backlog_samples.store(static_cast<int64_t>(backlog));
+  const double backlog_ms = static_cast<double>(backlog) * 1000.0 / session->sample_rate;
+  bool entered = false;
+  if (!session->catching_up && backlog_ms > kCatchUpEnterMillis) {
+    session->catching_up = true;
+    entered = true;
+    DebugLog(self, "Decoding fell behind; catching up");
+  } else if (session->catching_up && backlog_ms < kCatchUpExitMillis) {
+    session->catching_up = false;
+  }
+  std::lock_guard<std::mutex> lock(self->state->stats.mutex);
+  self->state->stats.catch_up_events += entered ? 1 : 0;
+  self->state->stats.peak_backlog_ms = std::max(self->state->stats.peak_backlog_ms, backlog_ms);
+}
+
+static void RunDecodeTask(PluginCore* self, RecognitionSession* session);
+
+// Queues a decode task for |session| unless one is already queued or
+// running; that task then picks up the new work itself.
+static void ScheduleDecode(PluginCore* self, RecognitionSession* session) {
+  session->decode_pending.store(true);
+  if (session->decode_scheduled.exchange(true)) {
+    return;
+  }
+  session->decode_enqueued_at = std::chrono::steady_clock::now();
+  self->state->scheduler->Submit([self, session] { RunDecodeTask(self, session); });
+}
+
+// Takes the recognizer once its builder is done. Returns false while it is
+// still being built; the builder wakes the session when it finishes.
+static bool AcquireRecognizer(PluginCore* self, RecognitionSession* session) {
+  if (!session->pending_recognizer.valid()) {
+    return true;
+  }
+  if (session->pending_recognizer.wait_for(std::chrono::seconds(0)) ==
+      std::future_status::timeout) {
+    return false;
+  }
+  const RecognizerSetup setup = session->pending_recognizer.get();
+  session->recognizer = setup.recognizer;
+  session->clock.fed = setup.fed_samples;
+  session->endpoint_on_vosk_result = setup.vosk_endpointer;
+  if (session->recognizer == nullptr) {
+    SendSessionError(self, session, "Failed to create Vosk recognizer", true);
+    session->session_end = SessionEnd::kStreamError;
+  } else if (session->wants_vosk_endpointer && !setup.vosk_endpointer) {
+    DebugLog(self, "libvosk lacks the endpointer API; using acoustic endpointing only");
+  }
+  return true;
+}
+
+// Reports `done` once every recognizer of the session delivered its final
+// result. Nothing touches the session after this.
+static void CompleteSession(PluginCore* self, RecognitionSession* session) {
+  if (session->race != nullptr && !session->cancel_requested.load()) {
+    // No candidate pulled clear before the end: the best scoring one wins.
+    LanguageRace& race = *session->race;
+    std::lock_guard<std::mutex> lock(race.mutex);
+    if (race.winner < 0) {
+      race.winner = race.leader;
+      ReleaseRaceWinnerLocked(self, session, race);
+    }
+  }
+  if (session->second_pass != nullptr && session->second_pass->recognizer != nullptr) {
+    session->vosk->FreeRecognizer(session->second_pass->recognizer);
+    session->second_pass->recognizer = nullptr;
+  }
+  RecordSessionEnd(self->state, session);
+  if (!session->cancel_requested.load()) {
+    if (session->reported_speech || session->lane_reported_speech.load()) {
+      SendSessionStatus(self, session, "done");
+    } else {
+      SendSessionStatus(self, session, "doneNoResult");
+    }
+  }
+  MarkSessionIdle(self->state, session);
+}
+
+static void ReleaseRecognizerSlot(PluginCore* self, RecognitionSession* session) {
+  if (session->open_recognizers.fetch_sub(1) == 1) {
+    CompleteSession(self, session);
+  }
+}
+
+// Re-decodes the oldest queued segment with the large model, within the
+// job's latency budget, and sends whichever final is available in time.
+static void RunSecondPassTask(PluginCore* self, RecognitionSession* session) {
+  SpeechToTextLinuxPluginState* state = self->state;
+  const VoskApi& vosk = *session->vosk;
+  SecondPass& pass = *session->second_pass;
+  SecondPassJob job;
+  {
+    std::lock_guard<std::mutex> lock(pass.mutex);
+    job = std::move(pass.jobs.front());
+    pass.jobs.pop_front();
+    pass.audio_jobs -= job.fallback_only ? 0 : 1;
+  }
+  const double cpu_started = ThreadCpuSeconds();
+  const bool cancelled = session->cancel_requested.load();
+  std::string json;
+  std::string text;
+  double confidence = -1.0;
+  bool in_time =
+      !cancelled && !job.fallback_only && std::chrono::steady_clock::now() < job.deadline;
+  if (in_time) {
+    for (const auto& chunk : job.chunks) {
+      pass.clock.Feed(chunk->first_sample, static_cast<int64_t>(chunk->samples.size()));
+      vosk.AcceptWaveform(pass.recognizer, chunk->samples.data(),
+                          static_cast<int>(chunk->samples.size()));
+      if (std::chrono::steady_clock::now() >= job.deadline) {
+        in_time = false;
+        break;
+      }
+    }
+    if (in_time) {
+      json = vosk.FinalResult(pass.recognizer);
+      text = ExtractJsonText(json, "text");
+      confidence = ExtractAverageConfidence(json);
+    } else {
+      vosk.Reset(pass.recognizer);
+    }
+  }
+  job.chunks.clear();
+  if (!cancelled) {
+    const bool use_second = in_time && !text.empty();
+    SendRecognition(self, session, use_second ? text : job.fallback_text,
+                    use_second ? confidence : job.fallback_confidence, true, job.span);
+    // Once per segment, whichever pass the app was sent.
+    const std::chrono::duration<double, std::milli> since_speech =
+        std::chrono::steady_clock::now() - job.speech_ended_at;
+    const double end_of_speech_ms =
+        job.speech_ended_at.time_since_epoch().count() != 0 ? since_speech.count() : -1.0;
+    if (use_second) {
+      SendWordsAndJournal(self, session, session->recognizer_name, pass.clock, json.c_str(),
+                          text, confidence, job.span, true, end_of_speech_ms);
+    } else {
+      SendWordTimings(self, session, session->recognizer_name, job.fallback_words);
+      JournalFinal(session, session->recognizer_name, job.fallback_text,
+                   job.fallback_confidence, job.fallback_words, job.span, false,
+                   end_of_speech_ms);
+    }
+    const std::chrono::duration<double, std::milli> latency =
+        std::chrono::steady_clock::now() - job.queued_at;
+    std::lock_guard<std::mutex> lock(state->stats.mutex);
+    if (use_second) {
+      state->stats.second_pass_latency.Record(latency.count());
+    } else {
+      state->stats.second_pass_fallbacks++;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(state->stats.mutex);
+    state->stats.decode_cpu_seconds += ThreadCpuSeconds() - cpu_started;
+  }
+  bool more = false;
+  {
+    std::lock_guard<std::mutex> lock(pass.mutex);
+    more = !pass.jobs.empty();
+    pass.scheduled = more;
+  }
+  if (more) {
+    state->scheduler->Submit([self, session] { RunSecondPassTask(self, session); });
+  }
+  ReleaseRecognizerSlot(self, session);
+}
+
+static void RunLaneTask(PluginCore* self, RecognitionSession* session,
+                        RecognizerLane* lane);
+
+static void ScheduleLane(PluginCore* self, RecognitionSession* session,
+                         RecognizerLane* lane) {
+  lane->decode_pending.store(true);
+  if (lane->decode_scheduled.exchange(true)) {
+    return;
+  }
+  lane->decode_enqueued_at = std::chrono::steady_clock::now();
+  // Two pointers fit std::function's inline storage; a third would make
+  // every lane wake-up allocate.
+  self->state->scheduler->Submit([self, lane] { RunLaneTask(self, lane->session, lane); });
+}
+
+// Hands one chunk to every lane of the session.
+static void PublishChunk(PluginCore* self, RecognitionSession* session,
+                         const AudioChunkRef& chunk) {
+  for (const auto& lane : session->lanes) {
+    if (lane->dropped.load()) {
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(lane->mutex);
+      if (lane->chunks.size() >= kMaxLaneBacklogChunks) {
+        lane->dropped_chunks++;
+        continue;
+      }
+      lane->chunks.push_back(chunk);
+    }
+    ScheduleLane(self, session, lane.get());
+  }
+}
+
+// Reads up to |max_frames| from the ring. With lanes or a second pass the
+// audio goes into a shared chunk that is published to the lanes and
+// returned in |chunk|; |data| then points into it. Standby audio only goes
+// to the keyword spotter.
+static size_t CaptureChunk(PluginCore* self, RecognitionSession* session,
+                           size_t max_frames, const int16_t** data, AudioChunkRef* chunk_out) {
+  chunk_out->reset();
+  if ((session->lanes.empty() && session->second_pass == nullptr) ||
+      session->standby != nullptr) {
+    std::vector<int16_t>& buffer = session->decode_buffer;
+    *data = buffer.data();
+    uint64_t skipped = 0;
+    const size_t frames =
+        session->ring->Read(buffer.data(), std::min(buffer.size(), max_frames), &skipped);
+    session->stream_read += static_cast<int64_t>(skipped + frames);
+    if (session->recording != nullptr && frames > 0) {
+      self->state->recorder->Append(session->recording.get(), buffer.data(), frames);
+    }
+    return frames;
+  }
+  std::shared_ptr<AudioChunk> chunk = session->chunk_pool.Take();
+  chunk->samples.resize(std::min(session->decode_buffer.size(), max_frames));
+  uint64_t skipped = 0;
+  const size_t frames =
+      session->ring->Read(chunk->samples.data(), chunk->samples.size(), &skipped);
+  session->stream_read += static_cast<int64_t>(skipped);
+  if (frames == 0) {
+    return 0;
+  }
+  chunk->samples.resize(frames);
+  chunk->first_sample = session->stream_read;
+  session->stream_read += static_cast<int64_t>(frames);
+  if (session->recording != nullptr) {
+    self->state->recorder->Append(session->recording.get(), chunk->samples.data(), frames);
+  }
+  chunk->captured_at =
+      std::chrono::steady_clock::now() -
+      std::chrono::microseconds(static_cast<int64_t>(session->ring->Available()) * 1000000 /
+                                session->sample_rate);
+  *data = chunk->samples.data();
+  PublishChunk(self, session, chunk);
+  *chunk_out = std::move(chunk);
+  return frames;
+}
+
+// Stops the stream, delivers the final result and recycles the recognizer.
+// Runs as the session's last decode task; lanes finish on their own tasks.
+static void FinishSession(PluginCore* self, RecognitionSession* session) {
+  SpeechToTextLinuxPluginState* state = self->state;
+  const VoskApi& vosk = *session->vosk;
+  state->reactor->Unwatch(&session->waker);
+  session->waker.DisarmDeadline();
+  {
+    // Release the device right away so a pipelined `listen` can open it.
+    std::lock_guard<std::mutex> lock(*state->device_mutex);
+    Pa_AbortStream(session->stream);
+    Pa_CloseStream(session->stream);
+    session->stream = nullptr;
+  }
+  const bool stopped = session->BeginFinalizing();
+  session->stream_closed.set_value();
+
+  // The microphone is closed from here on; report that before the possibly
+  // slow FinalResult so stop/cancel feel immediate. The final result and
+  // `done` still follow in order.
+  SendSessionStatus(self, session, "notListening");
+  if (stopped && session->stop_from_user) {
+    const std::chrono::duration<double, std::milli> latency =
+        std::chrono::steady_clock::now() - session->stop_requested_at;
+    std::lock_guard<std::mutex> lock(state->stats.mutex);
+    state->stats.stop_to_status.Record(latency.count());
+  }
+
+  // A session still in standby never heard its keyword: nothing to deliver.
+  const bool deliver = !session->cancel_requested.load() && session->standby == nullptr;
+  if (session->standby != nullptr) {
+    if (session->standby->spotter != nullptr) {
+      vosk.FreeRecognizer(session->standby->spotter);
+      session->standby->spotter = nullptr;
+    }
+    RecordStandbyStats(state, session, false);
+  }
+  if (deliver) {
+    // Hand the recognizers whatever was captured before the stream stopped.
+    const int16_t* data = nullptr;
+    AudioChunkRef chunk;
+    size_t frames = 0;
+    while ((frames = CaptureChunk(self, session, session->decode_buffer.size(), &data,
+                                  &chunk)) > 0) {
+      if (session->recognizer != nullptr && !session->dropped.load()) {
+        session->clock.Feed(session->stream_read - static_cast<int64_t>(frames),
+                            static_cast<int64_t>(frames));
+        vosk.AcceptWaveform(session->recognizer, data, static_cast<int>(frames));
+        session->decoded_samples += static_cast<int64_t>(frames);
+        TrackUtterance(&session->utterance_start, &session->utterance_end,
+                       session->stream_read - static_cast<int64_t>(frames),
+                       static_cast<int64_t>(frames));
+        if (session->second_pass != nullptr && !session->segment_overflowed) {
+          session->segment.push_back(std::move(chunk));
+        }
+      }
+    }
+  }
+  if (session->recording != nullptr) {
+    state->recorder->Close(session->recording.get());
+  }
+  for (const auto& lane : session->lanes) {
+    {
+      std::lock_guard<std::mutex> lock(lane->mutex);
+      lane->input_closed = true;
+    }
+    ScheduleLane(self, session, lane.get());
+  }
+  if (deliver && session->recognizer != nullptr && !session->dropped.load()) {
+    const std::string final_json = vosk.FinalResult(session->recognizer);
+    const std::string text = ExtractJsonText(final_json, "text");
+    if (!text.empty()) {
+      DeliverResult(self, session, final_json.c_str(), text, true);
+      session->reported_speech = true;
+    }
+  }
+
+  if (session->adaptive != nullptr) {
+    // Pool the session's own recognizer, never the light one.
+    AdaptiveDecoding& adaptive = *session->adaptive;
+    if (adaptive.use_light) {
+      std::swap(session->recognizer, adaptive.spare);
+      std::swap(session->clock, adaptive.spare_clock);
+      adaptive.use_light = false;
+    }
+    if (adaptive.spare != nullptr) {
+      vosk.FreeRecognizer(adaptive.spare);
+      adaptive.spare = nullptr;
+    }
+  }
+  RecycleRecognizer(state, session);
+  {
+    std::lock_guard<std::mutex> lock(state->stats.mutex);
+    state->stats.decoded_audio_seconds +=
+        static_cast<double>(session->decoded_samples) / session->sample_rate;
+    state->stats.catch_up_skipped_seconds +=
+        static_cast<double>(session->skipped_samples) / session->sample_rate;
+    state->stats.overflow_seconds +=
+        static_cast<double>(session->ring->dropped_samples()) / session->sample_rate;
+    state->stats.chunk_pool_misses += session->chunk_pool.misses();
+    const double cpu_seconds =
+        session->decode_cpu_seconds + ThreadCpuSeconds() - session->task_cpu_started;
+    state->stats.decode_cpu_seconds += cpu_seconds;
+    DecodeCost& cost = state->stats.decode_cost_by_alternatives[session->max_alternatives];
+    cost.audio_seconds += static_cast<double>(session->decoded_samples) / session->sample_rate;
+    cost.cpu_seconds += cpu_seconds;
+  }
+  ReleaseRecognizerSlot(self, session);
+}
+
+static void DeliverLaneResult(PluginCore* self, RecognitionSession* session,
+                              RecognizerLane* lane, const char* json,
+                              const std::string& text, bool final_result) {
+  const AudioSpan span = StreamSpan(session, lane->utterance_start, lane->utterance_end);
+  if (session->race != nullptr) {
+    DeliverRaceResult(self, session, lane->race_index, lane->clock, json, text, final_result,
+                      span);
+  } else {
+    const double confidence = final_result ? ExtractAverageConfidence(json) : -1.0;
+    SendLaneRecognition(self, session, lane, text, confidence, final_result, span);
+    if (final_result) {
+      SendWordsAndJournal(self, session, lane->name, lane->clock, json, text, confidence, span,
+                          false, -1.0);
+    }
+  }
+}
+
+// Decodes the chunks queued for one lane, up to one slice, and delivers the
+// lane's final result once the session stopped capturing.
+static void RunLaneTask(PluginCore* self, RecognitionSession* session,
+                        RecognizerLane* lane) {
+  SpeechToTextLinuxPluginState* state = self->state;
+  const VoskApi& vosk = *session->vosk;
+  {
+    const std::chrono::duration<double, std::milli> delay =
+        std::chrono::steady_clock::now() - lane->decode_enqueued_at;
+    std::lock_guard<std::mutex> lock(state->stats.mutex);
+    state->stats.decode_queue_delay.Record(delay.count());
+  }
+  const double cpu_started = ThreadCpuSeconds();
+  lane->decode_pending.store(false);
+  // A lane that lost the language pick ends right away.
+  const bool cancelled = session->cancel_requested.load() || lane->dropped.load();
+  if (lane->reset_pending.exchange(false) && lane->recognizer != nullptr) {
+    // Lost the previous utterance's pick and skipped its audio.
+    vosk.Reset(lane->recognizer);
+    lane->last_partial_text.clear();
+    lane->utterance_start = -1;
+  }
+  size_t budget = static_cast<size_t>(session->sample_rate) * kDecodeSliceMillis / 1000;
+  bool input_done = false;
+  while (budget > 0) {
+    AudioChunkRef chunk;
+    {
+      std::lock_guard<std::mutex> lock(lane->mutex);
+      if (cancelled) {
+        lane->chunks.clear();
+      }
+      if (lane->chunks.empty()) {
+        input_done = lane->input_closed || (lane->dropped.load() && !session->continuous);
+        break;
+      }
+      chunk = std::move(lane->chunks.front());
+      lane->chunks.pop_front();
+    }
+    const size_t frames = chunk->samples.size();
+    budget -= std::min(budget, frames);
+    if (lane->recognizer == nullptr) {
+      continue;
+    }
+    TrackUtterance(&lane->utterance_start, &lane->utterance_end, chunk->first_sample,
+                   static_cast<int64_t>(frames));
+    lane->clock.Feed(chunk->first_sample, static_cast<int64_t>(frames));
+    if (vosk.AcceptWaveform(lane->recognizer, chunk->samples.data(),
+                            static_cast<int>(frames)) != 0) {
+      const std::string json = vosk.Result(lane->recognizer);
+      const std::string text = ExtractJsonText(json, "text");
+      if (!text.empty()) {
+        session->lane_reported_speech.store(true);
+        DeliverLaneResult(self, session, lane, json.c_str(), text, true);
+      }
+      lane->utterance_start = -1;
+    } else if (lane->options.partial_words) {
+      const char* json = vosk.PartialResult(lane->recognizer);
+      std::string& text = lane->partial_scratch;
+      if (ExtractJsonTextTo(json, "partial", &text) && text != lane->last_partial_text) {
+        lane->last_partial_text.assign(text);
+        session->lane_reported_speech.store(true);
+        DeliverLaneResult(self, session, lane, json, text, false);
+      }
+    }
+  }
+  if (input_done && lane->recognizer != nullptr) {
+    if (!cancelled) {
+      const std::string json = vosk.FinalResult(lane->recognizer);
+      const std::string text = ExtractJsonText(json, "text");
+      if (!text.empty()) {
+        session->lane_reported_speech.store(true);
+        DeliverLaneResult(self, session, lane, json.c_str(), text, true);
+      }
+    }
+    vosk.FreeRecognizer(lane->recognizer);
+    lane->recognizer = nullptr;
+  }
+  {
+    std::lock_guard<std::mutex> lock(state->stats.mutex);
+    state->stats.decode_cpu_seconds += ThreadCpuSeconds() - cpu_started;
+    if (input_done) {
+      state->stats.lane_dropped_chunks += static_cast<int64_t>(lane->dropped_chunks);
+    }
+  }
+  if (input_done) {
+    // decode_scheduled stays set, so the finished lane is never queued again.
+    ReleaseRecognizerSlot(self, session);
+    return;
+  }
+  lane->decode_scheduled.store(false);
+  if (lane->decode_pending.load()) {
+    ScheduleLane(self, session, lane);
+  }
+}
+
+bool DecodeSlice(PluginCore* self, RecognitionSession* session) {
+  bool keep_listening = session->recognizer != nullptr && !session->stopping();
+  size_t budget = static_cast<size_t>(session->sample_rate) * kDecodeSliceMillis / 1000;
+  const int16_t* data = nullptr;
+  AudioChunkRef chunk;
+  size_t frames = 0;
+  size_t slice_frames = 0;
+  UpdateCatchUp(self, session);
+  size_t batch = static_cast<size_t>(session->frames_per_buffer);
+  if (session->catching_up) {
+    budget = static_cast<size_t>(session->sample_rate) * kCatchUpSliceMillis / 1000;
+    batch = session->decode_buffer.size();
+  }
+  const auto slice_started = std::chrono::steady_clock::now();
+  while (keep_listening && budget > 0 && !session->stopping() &&
+         (frames = CaptureChunk(self, session, std::min(budget, batch), &data, &chunk)) > 0) {
+    budget -= frames;
+    slice_frames += frames;
+    // Audio still queued behind this chunk was captured after it.
+    const auto captured_at =
+        std::chrono::steady_clock::now() -
+        std::chrono::microseconds(static_cast<int64_t>(session->ring->Available()) * 1000000 /
+                                  session->sample_rate);
+    keep_listening =
+        ProcessAudio(self, session, data, static_cast<int>(frames), chunk, captured_at);
+  }
+  if (keep_listening) {
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - slice_started;
+    TrackRealTimeFactor(self, session, elapsed.count(), slice_frames);
+  }
+  return keep_listening;
+}
+
+// Decodes up to one slice of queued audio. Returns true once the session
+// has been finished, after which it must not be touched.
+static bool DecodeStep(PluginCore* self, RecognitionSession* session) {
+  if (!AcquireRecognizer(self, session)) {
+    // Audio keeps queueing in the ring until the recognizer is ready.
+    return false;
+  }
+  bool keep_listening = DecodeSlice(self, session);
+  if (keep_listening && session->stopping()) {
+    keep_listening = false;
+  }
+  if (keep_listening && !CheckDeadlines(session, std::chrono::steady_clock::now())) {
+    keep_listening = false;
+  }
+  if (keep_listening) {
+    // Skipped while another call holds the device, e.g. a slow open; the
+    // next step checks again.
+    PaError active = 1;
+    {
+      std::unique_lock<std::mutex> device_lock(*self->state->device_mutex, std::try_to_lock);
+      if (device_lock.owns_lock()) {
+        active = Pa_IsStreamActive(session->stream);
+      }
+    }
+    if (active < 0) {
+      SendSessionError(self, session, DescribePaError(active), true);
+      session->session_end = SessionEnd::kStreamError;
+      keep_listening = false;
+    } else if (active == 0) {
+      keep_listening = false;
+    }
+  }
+  if (!keep_listening) {
+    FinishSession(self, session);
+    return true;
+  }
+  ArmNextDeadline(session);
+  if (session->ring->Available() > 0) {
+    // Out of budget; requeue behind the other sessions.
+    session->decode_pending.store(true);
+  }
+  return false;
+}
+
+static void RunDecodeTask(PluginCore* self, RecognitionSession* session) {
+  SpeechToTextLinuxPluginState* state = self->state;
+  {
+    const std::chrono::duration<double, std::milli> delay =
+        std::chrono::steady_clock::now() - session->decode_enqueued_at;
+    std::lock_guard<std::mutex> lock(state->stats.mutex);
+    session->queue_delay.Record(delay.count());
+    state->stats.decode_queue_delay.Record(delay.count());
+  }
+  session->task_cpu_started = ThreadCpuSeconds();
+  session->decode_pending.store(false);
+  if (DecodeStep(self, session)) {
+    return;
+  }
+  session->decode_cpu_seconds += ThreadCpuSeconds() - session->task_cpu_started;
+  session->decode_scheduled.store(false);
+  if (session->decode_pending.load()) {
+    ScheduleDecode(self, session);
+  }
+}
+
+void StartDecoding(PluginCore* self, RecognitionSession* session) {
+  SpeechToTextLinuxPluginState* state = self->state;
+  session->ResetRecognitionTimers();
+  state->reactor->Watch(&session->waker, [self, session] { ScheduleDecode(self, session); });
+  ScheduleDecode(self, session);
+}
+
+}  // namespace speech_to_text_linux
@@ -0,0 +1,73 @@
+#ifndef SPEECH_TO_TEXT_LINUX_DECODE_PIPELINE_H_
+#define SPEECH_TO_TEXT_LINUX_DECODE_PIPELINE_H_
+
+#include <portaudio.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "plugin_state.h"
+
+namespace speech_to_text_linux {
+
+void DebugLog(PluginCore* self, const std::string& message);
+
+void SendError(PluginCore* self, const std::string& message,
+               bool permanent);
+
+void SendSessionStatus(PluginCore* self, const RecognitionSession* session,
+                       const std::string& status);
+
+void SendSessionError(PluginCore* self, const RecognitionSession* session,
+                      const std::string& message, bool permanent);
+
+// Errors raised before a session starts capturing. Handle sessions report
+// them to their own callback only.
+void SendListenError(PluginCore* self, int64_t handle_id,
+                     const std::string& message);
+
+// Takes an idle recognizer for |sample_rate| from the pool, or returns null.
+PooledRecognizer TakePooledRecognizerLocked(SpeechToTextLinuxPluginState* state,
+                                            int sample_rate);
+
+// Waits for the recognizers that `listen` started building but will not use,
+// including lane recognizers it already took.
+void DiscardPendingRecognizer(RecognitionSession* session);
+
+// Ends a session that `listen` registered but could not start. It never
+// captured, so nothing else touches it.
+void AbandonStartingSession(SpeechToTextLinuxPluginState* state,
+                            RecognitionSession* session);
+
+// Word timings of |json|, from the recognizer behind |clock|, moved onto
+// the session's timeline: seconds since the stream's first sample. N-best
+// results score whole hypotheses only, so their words get |result_conf|,
+// the confidence the result was sent with. Returns false when the result
+// carries none.
+bool ExtractSessionWords(const RecognitionSession* session, const RecognizerClock& clock,
+                         const char* json, double result_conf,
+                         std::vector<WordTiming>* words);
+
+int CaptureCallback(const void* input, void* output, unsigned long frame_count,
+                    const PaStreamCallbackTimeInfo* time_info,
+                    PaStreamCallbackFlags status_flags, void* user_data);
+
+// Closes a segment of a continuous session: its final goes out and the
+// recognizer starts over without being rebuilt, so decoder state does not
+// accumulate over hours of dictation. |json| is the segment's result, or
+// empty to flush the recognizer first.
+void EndSegment(PluginCore* self, RecognitionSession* session,
+                std::string json);
+
+// Decodes up to one slice of the audio queued in the session's ring with
+// its own recognizer, delivering sound levels and results. Returns false
+// once the session should end, e.g. on an endpoint or a stop.
+bool DecodeSlice(PluginCore* self, RecognitionSession* session);
+
+// Hands a started session to the reactor and the decode workers.
+void StartDecoding(PluginCore* self, RecognitionSession* session);
+
+}  // namespace speech_to_text_linux
+
+#endif  // SPEECH_TO_TEXT_LINUX_DECODE_PIPELINE_H_
@@ -0,0 +1,217 @@
+#include "decode_scheduler.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace speech_to_text_linux {
+
+CaptureWaker::CaptureWaker() {
+  event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+}
+
+CaptureWaker::~CaptureWaker() {
+  if (event_fd_ >= 0) {
+    close(event_fd_);
+  }
+  if (timer_fd_ >= 0) {
+    close(timer_fd_);
+  }
+}
+
+void CaptureWaker::Notify() {
+  if (event_fd_ >= 0) {
+    const uint64_t one = 1;
+    ssize_t ignored = write(event_fd_, &one, sizeof(one));
+    (void)ignored;
+  }
+}
+
+void CaptureWaker::ArmDeadline(std::chrono::steady_clock::time_point deadline) {
+  if (timer_fd_ < 0) {
+    return;
+  }
+  // steady_clock is CLOCK_MONOTONIC on Linux, so its epoch matches the timer.
+  const auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      deadline.time_since_epoch());
+  struct itimerspec spec = {};
+  spec.it_value.tv_sec = static_cast<time_t>(since_epoch.count() / 1000000000);
+  spec.it_value.tv_nsec = static_cast<long>(since_epoch.count() % 1000000000);
+  if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+    spec.it_value.tv_nsec = 1;  // a zero value would disarm the timer
+  }
+  timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void CaptureWaker::DisarmDeadline() {
+  if (timer_fd_ >= 0) {
+    struct itimerspec spec = {};
+    timerfd_settime(timer_fd_, 0, &spec, nullptr);
+  }
+}
+
+void CaptureWaker::Consume(bool event, bool timer) {
+  uint64_t count = 0;
+  if (event && event_fd_ >= 0) {
+    ssize_t ignored = read(event_fd_, &count, sizeof(count));
+    (void)ignored;
+  }
+  if (timer && timer_fd_ >= 0) {
+    ssize_t ignored = read(timer_fd_, &count, sizeof(count));
+    (void)ignored;
+  }
+}
+
+DecodeScheduler::DecodeScheduler(size_t worker_count) {
+  worker_count = std::max<size_t>(worker_count, 1);
+  for (size_t i = 0; i < worker_count; ++i) {
+    workers_.emplace_back(new Worker());
+  }
+  for (size_t i = 0; i < worker_count; ++i) {
+    workers_[i]->thread = std::thread(&DecodeScheduler::Run, this, i);
+  }
+}
+
+DecodeScheduler::~DecodeScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    stopping_ = true;
+  }
+  idle_cv_.notify_all();
+  for (const auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+// Set on pool threads so tasks a worker submits stay on its own deque.
+static thread_local const DecodeScheduler* tls_scheduler = nullptr;
+static thread_local size_t tls_worker_index = 0;
+
+void DecodeScheduler::Submit(Task task) {
+  const size_t index = tls_scheduler == this
+                           ? tls_worker_index
+                           : next_worker_.fetch_add(1) % workers_.size();
+  {
+    std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+    workers_[index]->tasks.push_back(std::move(task));
+  }
+  queued_.fetch_add(1);
+  {
+    // Pairs with the predicate check in Run so the wake-up is not lost.
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+  }
+  idle_cv_.notify_one();
+}
+
+bool DecodeScheduler::TryTake(size_t index, Task* task) {
+  {
+    Worker& own = *workers_[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      *task = std::move(own.tasks.front());
+      own.tasks.pop_front();
+      return true;
+    }
+  }
+  for (size_t offset = 1; offset < workers_.size(); ++offset) {
+    Worker& victim = *workers_[(index + offset) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      *task = std::move(victim.tasks.back());
+      victim.tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+void DecodeScheduler::Run(size_t index) {
+  tls_scheduler = this;
+  tls_worker_index = index;
+  for (;;) {
+    Task task;
+    if (TryTake(index, &task)) {
+      queued_.fetch_sub(1);
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_cv_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+    if (stopping_) {
+      return;
+    }
+  }
+}
+
+CaptureReactor::CaptureReactor() : thread_(&CaptureReactor::Run, this) {}
+
+CaptureReactor::~CaptureReactor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  control_.Notify();
+  thread_.join();
+}
+
+void CaptureReactor::Watch(CaptureWaker* waker, std::function<void()> on_wake) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    watched_[waker] = std::move(on_wake);
+  }
+  control_.Notify();
+}
+
+void CaptureReactor::Unwatch(CaptureWaker* waker) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    watched_.erase(waker);
+  }
+  control_.Notify();
+}
+
+void CaptureReactor::Run() {
+  std::vector<struct pollfd> fds;
+  std::vector<CaptureWaker*> owners;
+  for (;;) {
+    fds.clear();
+    owners.clear();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_) {
+        return;
+      }
+      for (const auto& entry : watched_) {
+        fds.push_back({entry.first->event_fd(), POLLIN, 0});
+        fds.push_back({entry.first->timer_fd(), POLLIN, 0});
+        owners.push_back(entry.first);
+      }
+    }
+    fds.push_back({control_.event_fd(), POLLIN, 0});
+    if (poll(fds.data(), fds.size(), -1) <= 0) {
+      continue;
+    }
+    control_.Consume((fds.back().revents & POLLIN) != 0, false);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < owners.size(); ++i) {
+      const bool event = (fds[2 * i].revents & POLLIN) != 0;
+      const bool timer = (fds[2 * i + 1].revents & POLLIN) != 0;
+      if (!event && !timer) {
+        continue;
+      }
+      auto found = watched_.find(owners[i]);
+      if (found == watched_.end()) {
+        continue;  // unwatched while we were polling; its fds may be gone
+      }
+      found->first->Consume(event, timer);
+      found->second();
+    }
+  }
+}
+
+}  // namespace speech_to_text_linux
@@ -0,0 +1,151 @@
+#ifndef SPEECH_TO_TEXT_LINUX_DECODE_SCHEDULER_H_
+#define SPEECH_TO_TEXT_LINUX_DECODE_SCHEDULER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace speech_to_text_linux {
+
+// eventfd/timerfd pair signalling a session. Audio arrival, stop requests
+// and the listen/pause deadlines all wake it directly, so none of them waits
+// for a buffer read to complete.
+class CaptureWaker {
+ public:
+  CaptureWaker();
+  ~CaptureWaker();
+  CaptureWaker(const CaptureWaker&) = delete;
+  CaptureWaker& operator=(const CaptureWaker&) = delete;
+
+  // Safe to call from any thread, including the PortAudio callback.
+  void Notify();
+  void ArmDeadline(std::chrono::steady_clock::time_point deadline);
+  void DisarmDeadline();
+  // Clears whichever of the two descriptors fired.
+  void Consume(bool event, bool timer);
+
+  int event_fd() const { return event_fd_; }
+  int timer_fd() const { return timer_fd_; }
+
+ private:
+  int event_fd_ = -1;
+  int timer_fd_ = -1;
+};
+
+// Double-ended queue over a power-of-two ring that only ever grows. Unlike
+// std::deque it does not allocate and free blocks as items stream through.
+template <typename T>
+
+class RingQueue {
+ public:
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  T& front() { return slots_[head_]; }
+  T& back() { return slots_[(head_ + size_ - 1) & (slots_.size() - 1)]; }
+
+  void push_back(T value) {
+    if (size_ == slots_.size()) {
+      Grow();
+    }
+    slots_[(head_ + size_) & (slots_.size() - 1)] = std::move(value);
+    size_++;
+  }
+  // Popped slots are reset so they do not keep their contents alive.
+  void pop_front() {
+    slots_[head_] = T();
+    head_ = (head_ + 1) & (slots_.size() - 1);
+    size_--;
+  }
+  void pop_back() {
+    back() = T();
+    size_--;
+  }
+  void clear() {
+    while (!empty()) {
+      pop_front();
+    }
+  }
+
+ private:
+  void Grow() {
+    std::vector<T> grown(std::max<size_t>(slots_.size() * 2, 16));
+    for (size_t i = 0; i < size_; ++i) {
+      grown[i] = std::move(slots_[(head_ + i) & (slots_.size() - 1)]);
+    }
+    slots_.swap(grown);
+    head_ = 0;
+  }
+
+  std::vector<T> slots_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+};
+
+// Fixed pool of decode workers, one per core by default. Each worker owns a
+// deque: it takes its own tasks oldest first and, when idle, steals the
+// newest task of a busy worker. Tasks submitted by a worker stay on its deque
+// so a session keeps its cache-warm recognizer on one core where possible.
+class DecodeScheduler {
+ public:
+  using Task = std::function<void()>;
+
+  explicit DecodeScheduler(size_t worker_count);
+  ~DecodeScheduler();
+  DecodeScheduler(const DecodeScheduler&) = delete;
+  DecodeScheduler& operator=(const DecodeScheduler&) = delete;
+
+  void Submit(Task task);
+  size_t worker_count() const { return workers_.size(); }
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    RingQueue<Task> tasks;
+    std::thread thread;
+  };
+
+  void Run(size_t index);
+  bool TryTake(size_t index, Task* task);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cv_;
+  std::atomic<size_t> queued_{0};
+  std::atomic<size_t> next_worker_{0};
+  bool stopping_ = false;
+};
+
+// Single thread polling every capturing session's waker. Replaces a blocked
+// thread per session: it only turns wake-ups into decode tasks.
+class CaptureReactor {
+ public:
+  CaptureReactor();
+  ~CaptureReactor();
+  CaptureReactor(const CaptureReactor&) = delete;
+  CaptureReactor& operator=(const CaptureReactor&) = delete;
+
+  // |on_wake| runs on the reactor thread. Once Unwatch returns it is not
+  // called again for |waker|.
+  void Watch(CaptureWaker* waker, std::function<void()> on_wake);
+  void Unwatch(CaptureWaker* waker);
+
+ private:
+  void Run();
+
+  std::mutex mutex_;
+  std::map<CaptureWaker*, std::function<void()>> watched_;
+  CaptureWaker control_;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+}  // namespace speech_to_text_linux
+
+#endif  // SPEECH_TO_TEXT_LINUX_DECODE_SCHEDULER_H_
@@ -0,0 +1,79 @@
+#include "event_queue.h"
+
+#include <algorithm>
+
+namespace speech_to_text_linux {
+
+EventQueue::EventQueue(size_t capacity) : slots_(std::max<size_t>(capacity, 1)) {
+  for (auto& slot : slots_) {
+    slot.payload.reserve(256);
+  }
+  // Pop swaps it into the slots.
+  taken_.payload.reserve(256);
+}
+
+EventQueue::~EventQueue() {
+  for (auto& slot : slots_) {
+    if (slot.typed != nullptr) {
+      fl_value_unref(slot.typed);
+    }
+  }
+  for (auto& event : overflow_) {
+    if (event.typed != nullptr) {
+      fl_value_unref(event.typed);
+    }
+  }
+}
+
+EventQueue::Event* EventQueue::PushLocked() {
+  if (overflow_.empty() && size_ < slots_.size()) {
+    size_++;
+    return &slots_[(head_ + size_ - 1) % slots_.size()];
+  }
+  overflow_.emplace_back();
+  overflows_.fetch_add(1);
+  return &overflow_.back();
+}
+
+bool EventQueue::PostTyped(const char* method, FlValue* typed) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const bool was_empty = size_ == 0 && overflow_.empty();
+  Event* event = PushLocked();
+  event->method = method;
+  event->is_double = false;
+  event->payload.clear();
+  event->typed = typed;
+  return was_empty;
+}
+
+bool EventQueue::Post(const char* method, const std::string* payload, double value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const bool was_empty = size_ == 0 && overflow_.empty();
+  Event* event = PushLocked();
+  event->method = method;
+  event->is_double = payload == nullptr;
+  event->value = value;
+  if (payload != nullptr) {
+    event->payload.assign(*payload);
+  } else {
+    event->payload.clear();
+  }
+  return was_empty;
+}
+
+EventQueue::Event* EventQueue::Pop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (size_ > 0) {
+    std::swap(taken_, slots_[head_]);
+    head_ = (head_ + 1) % slots_.size();
+    size_--;
+  } else if (!overflow_.empty()) {
+    taken_ = std::move(overflow_.front());
+    overflow_.pop_front();
+  } else {
+    return nullptr;
+  }
+  return &taken_;
+}
+
+}  // namespace speech_to_text_linux
@@ -0,0 +1,65 @@
+#ifndef SPEECH_TO_TEXT_LINUX_EVENT_QUEUE_H_
+#define SPEECH_TO_TEXT_LINUX_EVENT_QUEUE_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace speech_to_text_linux {
+
+// Preallocated event slots; enough for a few seconds of partials and sound
+// levels from several sessions while the platform thread is busy.
+constexpr size_t kEventQueueSlots = 256;
+
+// Events for the Dart side, posted from any thread and sent in order from
+// the platform thread. Slots keep their payload buffers between events, so
+// posting does not allocate once the queue has warmed up; events that find
+// every slot taken spill into an overflow list, which does.
+class EventQueue {
+ public:
+  struct Event {
+    // Always a string literal.
+    const char* method = nullptr;
+    bool is_double = false;
+    double value = 0.0;
+    std::string payload;
+    // Typed payload sent as is instead of |payload|; owned by the event.
+    FlValue* typed = nullptr;
+  };
+
+  explicit EventQueue(size_t capacity);
+  ~EventQueue();
+
+  // Posts a string event, or a double one when |payload| is null. Returns
+  // true when the queue was empty, i.e. the consumer needs a wake-up.
+  bool Post(const char* method, const std::string* payload, double value);
+  // Same for a typed payload, which the queue takes over. Built per event,
+  // so only for rare ones such as finals.
+  bool PostTyped(const char* method, FlValue* typed);
+  // Consumer side: the oldest event, valid until the next call, or null.
+  // The consumer takes over |typed|.
+  Event* Pop();
+  int64_t overflows() const { return overflows_.load(); }
+
+ private:
+  // The next free slot, or a new overflow entry when every slot is taken.
+  Event* PushLocked();
+
+  std::mutex mutex_;
+  std::vector<Event> slots_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+  std::deque<Event> overflow_;
+  // Swapped with the slot being popped, so buffers circulate.
+  Event taken_;
+  std::atomic<int64_t> overflows_{0};
+};
+
+}  // namespace speech_to_text_linux
+
+#endif  // SPEECH_TO_TEXT_LINUX_EVENT_QUEUE_H_
@@ -0,0 +1,422 @@
+#include "json_payloads.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+namespace speech_to_text_linux {
+
+constexpr int kPartialResult = 0;
+constexpr int kFinalResult = 2;
+
+void AppendEscapedJson(std::string* out, const std::string& value) {
+  for (unsigned char ch : value) {
+    switch (ch) {
+      case '\\':
+        out->append("\\\\");
+        break;
+      case '"':
+        out->append("\\\"");
+        break;
+      case '\b':
+        out->append("\\b");
+        break;
+      case '\f':
+        out->append("\\f");
+        break;
+      case '\n':
+        out->append("\\n");
+        break;
+      case '\r':
+        out->append("\\r");
+        break;
+      case '\t':
+        out->append("\\t");
+        break;
+      default:
+        if (ch < 0x20) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04X", static_cast<unsigned>(ch));
+          out->append(escaped);
+        } else {
+          out->push_back(static_cast<char>(ch));
+        }
+        break;
+    }
+  }
+}
+
+void AppendFixed(std::string* out, double value, int decimals) {
+  long long scale = 1;
+  for (int i = 0; i < decimals; ++i) {
+    scale *= 10;
+  }
+  const long long scaled = std::llround(std::fabs(value) * static_cast<double>(scale));
+  char digits[48];
+  snprintf(digits, sizeof(digits), "%s%lld.%0*lld", value < 0.0 && scaled != 0 ? "-" : "",
+           scaled / scale, decimals, scaled % scale);
+  out->append(digits);
+}
+
+std::string EscapeJson(const std::string& value) {
+  std::string escaped;
+  AppendEscapedJson(&escaped, value);
+  return escaped;
+}
+
+std::string BuildErrorJson(const std::string& message, bool permanent) {
+  std::ostringstream oss;
+  oss << "{\"errorMsg\":\"" << EscapeJson(message) << "\",\"permanent\":"
+      << (permanent ? "true" : "false") << "}";
+  return oss.str();
+}
+
+void AppendSessionIds(std::string* out, int64_t session_id, int64_t handle_id) {
+  char number[64];
+  int length = 0;
+  if (session_id != 0) {
+    length = snprintf(number, sizeof(number), "\"sessionId\":%lld",
+                      static_cast<long long>(session_id));
+  }
+  if (handle_id != 0) {
+    snprintf(number + length, sizeof(number) - length, "%s\"handleId\":%lld",
+             length > 0 ? "," : "", static_cast<long long>(handle_id));
+  }
+  out->append(number);
+}
+
+// Appends one `alternates` entry, with the confidence clamped to -1..1.
+static void AppendAlternate(std::string* out, const std::string& text, double confidence) {
+  if (confidence < 0.0) {
+    confidence = -1.0;
+  } else if (confidence > 1.0) {
+    confidence = 1.0;
+  }
+  out->append("{\"recognizedWords\":\"");
+  AppendEscapedJson(out, text);
+  out->append("\",\"confidence\":");
+  AppendFixed(out, confidence, 3);
+  out->push_back('}');
+}
+
+void BuildRecognitionPayload(std::string* out, const std::string& text,
+                             double confidence, bool final_result, int64_t session_id,
+                             int64_t handle_id, const std::string& recognizer,
+                             const AudioSpan& span,
+                             const std::vector<Alternative>* alternates) {
+  char number[96];
+  out->assign("{\"alternates\":[");
+  if (alternates != nullptr && !alternates->empty()) {
+    for (size_t i = 0; i < alternates->size(); ++i) {
+      if (i > 0) {
+        out->push_back(',');
+      }
+      AppendAlternate(out, (*alternates)[i].text, (*alternates)[i].confidence);
+    }
+  } else {
+    AppendAlternate(out, text, confidence);
+  }
+  snprintf(number, sizeof(number), "],\"resultType\":%d,",
+           final_result ? kFinalResult : kPartialResult);
+  out->append(number);
+  AppendSessionIds(out, session_id, handle_id);
+  if (span.known()) {
+    out->append(",\"audioStartMillis\":");
+    AppendFixed(out, span.start_ms, 3);
+    out->append(",\"audioEndMillis\":");
+    AppendFixed(out, span.end_ms, 3);
+  }
+  out->append(",\"recognizer\":\"");
+  AppendEscapedJson(out, recognizer);
+  out->append("\"}");
+}
+
+std::string BuildSessionStatusJson(int64_t session_id, int64_t handle_id,
+                                   const std::string& status) {
+  std::string json("{");
+  AppendSessionIds(&json, session_id, handle_id);
+  json.append(",\"status\":\"");
+  AppendEscapedJson(&json, status);
+  json.append("\"}");
+  return json;
+}
+
+std::string BuildSessionErrorJson(int64_t session_id, int64_t handle_id,
+                                  const std::string& message, bool permanent) {
+  std::string json("{");
+  AppendSessionIds(&json, session_id, handle_id);
+  json.append(",\"status\":\"error\",\"errorMsg\":\"");
+  AppendEscapedJson(&json, message);
+  json.append(permanent ? "\",\"permanent\":true}" : "\",\"permanent\":false}");
+  return json;
+}
+
+void BuildSessionSoundLevelJson(std::string* out, int64_t session_id, int64_t handle_id,
+                                double level) {
+  out->assign("{");
+  AppendSessionIds(out, session_id, handle_id);
+  out->append(",\"level\":");
+  AppendFixed(out, level, 2);
+  out->push_back('}');
+}
+
+bool ExtractJsonTextTo(const char* json, const char* key, std::string* value) {
+  value->clear();
+  if (json == nullptr) {
+    return false;
+  }
+  const size_t key_length = strlen(key);
+  const char* pos = json;
+  while ((pos = strstr(pos, key)) != nullptr) {
+    if (pos > json && pos[-1] == '"' && pos[key_length] == '"') {
+      break;
+    }
+    pos += key_length;
+  }
+  if (pos == nullptr || (pos = strchr(pos + key_length, ':')) == nullptr) {
+    return false;
+  }
+  pos++;
+  while (*pos != '\0' && std::isspace(static_cast<unsigned char>(*pos))) {
+    pos++;
+  }
+  if (*pos != '"') {
+    return false;
+  }
+  pos++;
+  while (*pos != '\0' && *pos != '"') {
+    if (*pos == '\\' && pos[1] != '\0') {
+      switch (pos[1]) {
+        case 'n':
+          value->push_back('\n');
+          break;
+        case 't':
+          value->push_back('\t');
+          break;
+        default:
+          value->push_back(pos[1]);
+          break;
+      }
+      pos += 2;
+      continue;
+    }
+    value->push_back(*pos++);
+  }
+  return !value->empty();
+}
+
+std::string ExtractJsonText(const std::string& json, const std::string& key) {
+  std::string value;
+  ExtractJsonTextTo(json.c_str(), key.c_str(), &value);
+  return value;
+}
+
+double ExtractConfidenceSum(const std::string& json, int* word_count) {
+  double sum = 0.0;
+  int count = 0;
+  std::size_t pos = 0;
+  while (true) {
+    pos = json.find("\"conf\"", pos);
+    if (pos == std::string::npos) {
+      break;
+    }
+    pos = json.find(':', pos);
+    if (pos == std::string::npos) {
+      break;
+    }
+    pos++;
+    while (pos < json.size() && std::isspace(static_cast<unsigned char>(json[pos]))) {
+      pos++;
+    }
+    std::size_t end = pos;
+    while (end < json.size()) {
+      char ch = json[end];
+      if ((ch >= '0' && ch <= '9') || ch == '.' || ch == '-' || ch == '+') {
+        end++;
+      } else {
+        break;
+      }
+    }
+    if (end <= pos) {
+      break;
+    }
+    try {
+      const double value = std::stod(json.substr(pos, end - pos));
+      sum += value;
+      count++;
+    } catch (...) {
+      // ignore parsing failures
+    }
+    pos = end;
+  }
+  *word_count = count;
+  return sum;
+}
+
+double ExtractAverageConfidence(const std::string& json) {
+  int count = 0;
+  const double sum = ExtractConfidenceSum(json, &count);
+  if (count == 0) {
+    return -1.0;
+  }
+  return sum / static_cast<double>(count);
+}
+
+// Reads a JSON number at |pos| without strtod, which follows the process
+// locale. Returns the position after it, or |pos| when there is none.
+static const char* ParseJsonNumber(const char* pos, double* value) {
+  const char* cursor = pos;
+  const bool negative = *cursor == '-';
+  if (negative) {
+    cursor++;
+  }
+  double number = 0.0;
+  const char* digits = cursor;
+  while (*cursor >= '0' && *cursor <= '9') {
+    number = number * 10.0 + (*cursor++ - '0');
+  }
+  if (*cursor == '.') {
+    double scale = 0.1;
+    for (cursor++; *cursor >= '0' && *cursor <= '9'; cursor++, scale *= 0.1) {
+      number += (*cursor - '0') * scale;
+    }
+  }
+  if (cursor == digits) {
+    return pos;
+  }
+  if (*cursor == 'e' || *cursor == 'E') {
+    cursor++;
+    const bool negative_exponent = *cursor == '-';
+    if (*cursor == '-' || *cursor == '+') {
+      cursor++;
+    }
+    int exponent = 0;
+    while (*cursor >= '0' && *cursor <= '9') {
+      exponent = exponent * 10 + (*cursor++ - '0');
+    }
+    number *= std::pow(10.0, negative_exponent ? -exponent : exponent);
+  }
+  *value = negative ? -number : number;
+  return cursor;
+}
+
+// Reads the JSON string starting at the quote at |pos| into |out|. Returns
+// the position after the closing quote.
+static const char* ParseJsonString(const char* pos, std::string* out) {
+  out->clear();
+  pos++;
+  while (*pos != '\0' && *pos != '"') {
+    if (*pos == '\\' && pos[1] != '\0') {
+      switch (pos[1]) {
+        case 'n':
+          out->push_back('\n');
+          break;
+        case 't':
+          out->push_back('\t');
+          break;
+        default:
+          out->push_back(pos[1]);
+          break;
+      }
+      pos += 2;
+      continue;
+    }
+    out->push_back(*pos++);
+  }
+  return *pos == '"' ? pos + 1 : pos;
+}
+
+bool ExtractWordTimings(const char* json, std::vector<WordTiming>* words) {
+  words->clear();
+  const char* pos = json != nullptr ? strstr(json, "\"result\"") : nullptr;
+  if (pos == nullptr || (pos = strchr(pos, '[')) == nullptr) {
+    return false;
+  }
+  std::string key;
+  WordTiming* word = nullptr;
+  for (pos++; *pos != '\0' && *pos != ']';) {
+    if (*pos == '{') {
+      words->emplace_back();
+      word = &words->back();
+      pos++;
+    } else if (*pos == '"' && word != nullptr) {
+      pos = ParseJsonString(pos, &key);
+      while (*pos == ':' || std::isspace(static_cast<unsigned char>(*pos))) {
+        pos++;
+      }
+      if (*pos == '"') {
+        pos = ParseJsonString(pos, key == "word" ? &word->word : &key);
+        continue;
+      }
+      double value = 0.0;
+      const char* next = ParseJsonNumber(pos, &value);
+      if (key == "start") {
+        word->start = value;
+      } else if (key == "end") {
+        word->end = value;
+      } else if (key == "conf") {
+        word->conf = value;
+      }
+      pos = next == pos ? pos + 1 : next;
+    } else {
+      pos++;
+    }
+  }
+  return !words->empty();
+}
+
+bool ExtractAlternatives(const char* json, std::vector<Alternative>* alternatives) {
+  alternatives->clear();
+  const char* pos = json != nullptr ? strstr(json, "\"alternatives\"") : nullptr;
+  if (pos == nullptr || (pos = strchr(pos, '[')) == nullptr) {
+    return false;
+  }
+  std::string key;
+  // Nesting below the list: 1 inside an entry, deeper inside its words.
+  int depth = 0;
+  for (pos++; *pos != '\0';) {
+    const char ch = *pos;
+    if (ch == '"') {
+      pos = ParseJsonString(pos, &key);
+      if (depth != 1) {
+        continue;
+      }
+      while (*pos == ':' || std::isspace(static_cast<unsigned char>(*pos))) {
+        pos++;
+      }
+      if (key == "text" && *pos == '"') {
+        pos = ParseJsonString(pos, &alternatives->back().text);
+      } else if (key == "confidence") {
+        pos = ParseJsonNumber(pos, &alternatives->back().confidence);
+      }
+      continue;
+    }
+    if (ch == '{' || ch == '[') {
+      if (depth++ == 0 && ch == '{') {
+        alternatives->emplace_back();
+      }
+    } else if ((ch == '}' || ch == ']') && depth-- == 0) {
+      break;
+    }
+    pos++;
+  }
+  if (alternatives->empty()) {
+    return false;
+  }
+  double best = alternatives->front().confidence;
+  for (const Alternative& alternative : *alternatives) {
+    best = std::max(best, alternative.confidence);
+  }
+  double total = 0.0;
+  for (Alternative& alternative : *alternatives) {
+    alternative.confidence = std::exp(alternative.confidence - best);
+    total += alternative.confidence;
+  }
+  for (Alternative& alternative : *alternatives) {
+    alternative.confidence /= total;
+  }
+  return true;
+}
+
+}  // namespace speech_to_text_linux
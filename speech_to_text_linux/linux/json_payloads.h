@@ -0,0 +1,104 @@
+#ifndef SPEECH_TO_TEXT_LINUX_JSON_PAYLOADS_H_
+#define SPEECH_TO_TEXT_LINUX_JSON_PAYLOADS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace speech_to_text_linux {
+
+// CLOCK_MONOTONIC times, in milliseconds, of the first and last captured
+// sample behind a result; negative when unknown.
+struct AudioSpan {
+  double start_ms = -1.0;
+  double end_ms = -1.0;
+
+  bool known() const { return start_ms >= 0.0; }
+  // Grows the span to cover |other| as well.
+  void Extend(const AudioSpan& other) {
+    if (!other.known()) {
+      return;
+    }
+    start_ms = known() ? std::min(start_ms, other.start_ms) : other.start_ms;
+    end_ms = std::max(end_ms, other.end_ms);
+  }
+};
+
+// One entry of the `result` array Vosk adds when word timings are on.
+struct WordTiming {
+  std::string word;
+  double start = 0.0;
+  double end = 0.0;
+  // -1 when the entry has none, as in N-best results.
+  double conf = -1.0;
+};
+
+// One entry of the N-best list Vosk returns with `maxAlternatives`.
+struct Alternative {
+  std::string text;
+  double confidence = 0.0;
+};
+
+// Appends |value| to |out| as the body of a JSON string.
+void AppendEscapedJson(std::string* out, const std::string& value);
+
+// Appends |value| with |decimals| fixed decimals. Done by hand because
+// printf follows the process locale, which GTK sets to the user's, and a
+// decimal comma would break the JSON.
+void AppendFixed(std::string* out, double value, int decimals);
+
+std::string EscapeJson(const std::string& value);
+
+std::string BuildErrorJson(const std::string& message, bool permanent);
+
+// Appends `"sessionId":…` and, for sessions started through a
+// `createSession` handle, `"handleId":…`. A zero |session_id| (an error
+// raised before the session existed) is left out.
+void AppendSessionIds(std::string* out, int64_t session_id, int64_t handle_id);
+
+// Writes a result payload into |out|, reusing its buffer; results go out
+// for nearly every chunk while someone speaks. A non-empty |alternates|
+// list replaces |text| and |confidence|; a known |span| adds
+// `audioStartMillis` and `audioEndMillis`.
+void BuildRecognitionPayload(std::string* out, const std::string& text,
+                             double confidence, bool final_result, int64_t session_id,
+                             int64_t handle_id, const std::string& recognizer,
+                             const AudioSpan& span,
+                             const std::vector<Alternative>* alternates = nullptr);
+
+std::string BuildSessionStatusJson(int64_t session_id, int64_t handle_id,
+                                   const std::string& status);
+
+std::string BuildSessionErrorJson(int64_t session_id, int64_t handle_id,
+                                  const std::string& message, bool permanent);
+
+void BuildSessionSoundLevelJson(std::string* out, int64_t session_id, int64_t handle_id,
+                                double level);
+
+// Copies the string value of |key| in |json| into |value|, reusing its
+// buffer. Returns false, with |value| empty, when there is none.
+bool ExtractJsonTextTo(const char* json, const char* key, std::string* value);
+
+std::string ExtractJsonText(const std::string& json, const std::string& key);
+
+// Sums every "conf" value in a Vosk result and reports how many there were.
+double ExtractConfidenceSum(const std::string& json, int* word_count);
+
+double ExtractAverageConfidence(const std::string& json);
+
+// Collects the word timings of a Vosk result in a single pass over |json|;
+// |words| keeps its capacity between calls. Returns false when the result
+// carries none.
+bool ExtractWordTimings(const char* json, std::vector<WordTiming>* words);
+
+// Collects the `alternatives` list of a Vosk result in a single pass over
+// |json|, skipping each entry's word list. Vosk scores an entry with its
+// log-likelihood, so the scores are turned into each entry's share of the
+// list's total likelihood (0..1, summing to 1). Returns false when the
+// result carries no list.
+bool ExtractAlternatives(const char* json, std::vector<Alternative>* alternatives);
+
+}  // namespace speech_to_text_linux
+
+#endif  // SPEECH_TO_TEXT_LINUX_JSON_PAYLOADS_H_
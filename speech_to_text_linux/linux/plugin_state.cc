@@ -0,0 +1,182 @@
+#include "plugin_state.h"
+
+#include <dlfcn.h>
+#include <time.h>
+
+#include <fstream>
+#include <thread>
+
+#include "audio_device.h"
+
+namespace speech_to_text_linux {
+
+SpeechToTextLinuxPluginState::~SpeechToTextLinuxPluginState() {
+  for (const auto& session : sessions) {
+    // Results of sessions already finalizing are dropped too.
+    session->cancel_requested.store(true);
+    session->RequestStop(true, false, std::chrono::steady_clock::now());
+  }
+  // Give the decode tasks a moment to tear the sessions down before the
+  // workers go away. Closing a stream takes milliseconds.
+  {
+    std::unique_lock<std::mutex> lock(idle_mutex);
+    idle_changed.wait_for(lock, std::chrono::seconds(2), [this] {
+      for (const auto& session : sessions) {
+        if (!session->finished()) {
+          return false;
+        }
+      }
+      return true;
+    });
+  }
+  reactor.reset();
+  scheduler.reset();
+  recorder.reset();
+  journals.clear();
+  current_session.reset();
+  handles.clear();
+  sessions.clear();
+  ClearRecognizerPoolLocked();
+  for (const auto& entry : lane_models) {
+    vosk.FreeModel(entry.second);
+  }
+  lane_models.clear();
+  for (VoskModel* retired : retired_models) {
+    vosk.FreeModel(retired);
+  }
+  retired_models.clear();
+  if (model != nullptr && vosk.Ready()) {
+    vosk.FreeModel(model);
+    model = nullptr;
+  }
+  if (listen_defaults != nullptr) {
+    fl_value_unref(listen_defaults);
+    listen_defaults = nullptr;
+  }
+  // The start-up tasks are not waited for on the platform thread: one that
+  // is still running is handed to a thread that releases its result.
+  vosk.Unload();
+  if (port_audio.valid()) {
+    std::shared_future<PortAudioStart> pending = std::move(port_audio);
+    std::thread([pending] {
+      if (pending.get().error == paNoError) {
+        ReleasePortAudio();
+      }
+    }).detach();
+  }
+  if (vosk_preload.valid()) {
+    std::shared_future<VoskPreload> pending = std::move(vosk_preload);
+    std::thread([pending] {
+      if (pending.get().handle != nullptr) {
+        dlclose(pending.get().handle);
+      }
+    }).detach();
+  }
+}
+
+void SpeechToTextLinuxPluginState::StartVoskPreload() {
+  vosk_preload = std::async(std::launch::async, []() {
+                   const auto started = std::chrono::steady_clock::now();
+                   VoskPreload preload;
+                   preload.handle = PreloadVoskLibrary();
+                   const std::chrono::duration<double, std::milli> elapsed =
+                       std::chrono::steady_clock::now() - started;
+                   preload.millis = elapsed.count();
+                   return preload;
+                 }).share();
+}
+
+void SpeechToTextLinuxPluginState::StartPortAudio() {
+  port_audio = std::async(std::launch::async, []() {
+                 const auto started = std::chrono::steady_clock::now();
+                 PortAudioStart start;
+                 start.error = AcquirePortAudio();
+                 const std::chrono::duration<double, std::milli> elapsed =
+                     std::chrono::steady_clock::now() - started;
+                 start.millis = elapsed.count();
+                 return start;
+               }).share();
+}
+
+PaError SpeechToTextLinuxPluginState::WaitForPortAudio() {
+  if (port_audio.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+    return port_audio.get().error;
+  }
+  const auto started = std::chrono::steady_clock::now();
+  const PaError error = port_audio.get().error;
+  const std::chrono::duration<double, std::milli> waited =
+      std::chrono::steady_clock::now() - started;
+  std::lock_guard<std::mutex> lock(stats.mutex);
+  stats.port_audio_wait.Record(waited.count());
+  return error;
+}
+
+void SpeechToTextLinuxPluginState::ReapFinishedSessionsLocked() {
+  auto it = sessions.begin();
+  while (it != sessions.end()) {
+    if ((*it)->finished()) {
+      it = sessions.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  if (sessions.empty()) {
+    for (VoskModel* retired : retired_models) {
+      vosk.FreeModel(retired);
+    }
+    retired_models.clear();
+  }
+}
+
+void SpeechToTextLinuxPluginState::ClearRecognizerPoolLocked() {
+  for (const auto& pooled : recognizer_pool) {
+    vosk.FreeRecognizer(pooled.recognizer);
+  }
+  recognizer_pool.clear();
+}
+
+int64_t ReadProcStatusKb(const std::string& key) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, key.size(), key) == 0 && line.size() > key.size() &&
+        line[key.size()] == ':') {
+      try {
+        return std::stoll(line.substr(key.size() + 1));
+      } catch (...) {
+        return -1;
+      }
+    }
+  }
+  return -1;
+}
+
+double ThreadCpuSeconds() {
+  struct timespec now;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) {
+    return 0.0;
+  }
+  return static_cast<double>(now.tv_sec) + static_cast<double>(now.tv_nsec) / 1e9;
+}
+
+PluginCore::~PluginCore() {
+  // Calls still running finish first; they use the state.
+  delete control;
+  delete state;
+  if (event_source != nullptr) {
+    g_source_destroy(event_source);
+    g_source_unref(event_source);
+  }
+  delete events;
+  if (main_context != nullptr) {
+    g_main_context_unref(main_context);
+  }
+}
+
+std::shared_ptr<PluginCore> MakePluginCore() {
+  return std::shared_ptr<PluginCore>(new PluginCore(), [](PluginCore* core) {
+    std::thread([core]() { delete core; }).detach();
+  });
+}
+
+}  // namespace speech_to_text_linux
@@ -0,0 +1,182 @@
+#ifndef SPEECH_TO_TEXT_LINUX_PLUGIN_STATE_H_
+#define SPEECH_TO_TEXT_LINUX_PLUGIN_STATE_H_
+
+#include <flutter_linux/flutter_linux.h>
+#include <portaudio.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "control_worker.h"
+#include "decode_scheduler.h"
+#include "event_queue.h"
+#include "recognition_session.h"
+#include "session_output.h"
+#include "vosk_api.h"
+
+namespace speech_to_text_linux {
+
+// Idle recognizer kept for reuse by the next session at the same rate.
+struct PooledRecognizer {
+  VoskRecognizer* recognizer;
+  int sample_rate;
+  int64_t fed_samples;
+};
+
+constexpr size_t kMaxPooledRecognizers = 2;
+
+// A session created by `createSession`: its listen options and the capture
+// currently running for it. Handles are how several sources are transcribed
+// at once against the shared model.
+struct SessionHandle {
+  SessionHandle() = default;
+  SessionHandle(const SessionHandle&) = delete;
+  SessionHandle& operator=(const SessionHandle&) = delete;
+  ~SessionHandle() {
+    if (options != nullptr) {
+      fl_value_unref(options);
+    }
+  }
+
+  FlValue* options = nullptr;
+  std::shared_ptr<RecognitionSession> active;
+};
+
+// Results of the start-up tasks run in the background at registration.
+// They hold no reference to the plugin state, which may go away first.
+struct PortAudioStart {
+  PaError error = paNoError;
+  double millis = 0.0;
+};
+
+struct VoskPreload {
+  void* handle = nullptr;
+  double millis = 0.0;
+};
+
+// Time a background start-up task took, or 0 while it is still running.
+template <typename T>
+double StartupMillis(const std::shared_future<T>& task) {
+  return task.valid() && task.wait_for(std::chrono::seconds(0)) == std::future_status::ready
+             ? task.get().millis
+             : 0.0;
+}
+
+class SpeechToTextLinuxPluginState {
+ public:
+  SpeechToTextLinuxPluginState() = default;
+  ~SpeechToTextLinuxPluginState();
+
+  // Drops every session whose teardown has completed.
+  void ReapFinishedSessionsLocked();
+  void ClearRecognizerPoolLocked();
+  // Acquires PortAudio on a background thread. Called once at
+  // registration, so app start-up does not wait for device probing.
+  void StartPortAudio();
+  // Maps libvosk on a background thread, also at registration.
+  void StartVoskPreload();
+  // Blocks until PortAudio is up; only calls that need a device wait.
+  PaError WaitForPortAudio();
+
+  // Guards the fields below. Nothing slow runs under it: models load
+  // outside it and PortAudio calls take |device_mutex| instead.
+  std::mutex mutex;
+  // Serializes PortAudio calls, e.g. a decode task closing its stream
+  // while `listen` opens another. Never waited for while |mutex| is held,
+  // which cheap calls take on the platform thread.
+  // Shared with the thread opening a stream, which may outlive the plugin.
+  std::shared_ptr<std::mutex> device_mutex = std::make_shared<std::mutex>();
+  std::atomic<bool> debug_logging{false};
+  std::atomic<bool> initialized{false};
+  std::shared_future<PortAudioStart> port_audio;
+  // libvosk mapped in the background at registration; VoskApi::Load then
+  // finds it already loaded. Held until the state goes away.
+  std::shared_future<VoskPreload> vosk_preload;
+  // Signalled whenever a session becomes idle, so teardown can wait for
+  // the sessions without polling.
+  std::mutex idle_mutex;
+  std::condition_variable idle_changed;
+  // Plugin creation, for the time to the first recognition result.
+  const std::chrono::steady_clock::time_point created_at = std::chrono::steady_clock::now();
+  std::atomic<bool> first_result_sent{false};
+
+  std::string model_path;
+  std::string locale_tag = "en-US";
+  std::string locale_label = "en-US:en-US (Vosk)";
+
+  // Linux listen options passed to `initialize`, used as defaults for every
+  // `listen`.
+  FlValue* listen_defaults = nullptr;
+  PipelineStats stats;
+
+  // Created by the first `listen`; `decode_threads` of 0 means one per core.
+  int decode_threads = 0;
+  std::unique_ptr<DecodeScheduler> scheduler;
+  std::unique_ptr<CaptureReactor> reactor;
+  // Created by the first recorded session.
+  std::unique_ptr<SessionRecorder> recorder;
+  // Transcript journals by path, opened by the first session using each.
+  std::map<std::string, std::unique_ptr<TranscriptJournal>> journals;
+
+  VoskModel* model = nullptr;
+  VoskApi vosk;
+  // Models used by recognizer lanes, by path; the main model is not in here.
+  std::map<std::string, VoskModel*> lane_models;
+  // Lane models a later `initialize` no longer asked for. A running session
+  // may still build recognizers from them, so they are freed once none is
+  // left.
+  std::vector<VoskModel*> retired_models;
+
+  // The session `stop`/`cancel` act on and whose events use the legacy
+  // callbacks. Older sessions finishing in the background only report
+  // through the session-tagged callbacks.
+  std::shared_ptr<RecognitionSession> current_session;
+  std::atomic<int64_t> current_session_id{0};
+  std::vector<std::shared_ptr<RecognitionSession>> sessions;
+  std::map<int64_t, std::unique_ptr<SessionHandle>> handles;
+  int64_t next_session_id = 1;
+  std::vector<PooledRecognizer> recognizer_pool;
+};
+
+// Everything the plugin's threads work on. The plugin and every method call
+// in flight share it, so a call still loading a model or opening a device
+// keeps it alive past dispose; whichever lets go last hands the teardown,
+// which joins the workers, to a thread of its own (see MakePluginCore).
+struct PluginCore {
+  PluginCore() = default;
+  PluginCore(const PluginCore&) = delete;
+  PluginCore& operator=(const PluginCore&) = delete;
+  ~PluginCore();
+
+  SpeechToTextLinuxPluginState* state = nullptr;
+  // Only used on the platform thread; cleared by dispose.
+  FlMethodChannel* channel = nullptr;
+  GMainContext* main_context = nullptr;
+  // Drained by |event_source| on the main context. Dispose destroys the
+  // source; events posted after that are only freed.
+  EventQueue* events = nullptr;
+  GSource* event_source = nullptr;
+  // Runs every method call but `hasPermission`.
+  ControlWorker* control = nullptr;
+};
+
+// The teardown waits for calls in progress, decode tasks and devices
+// closing, so it never runs on the thread that let go of the core.
+std::shared_ptr<PluginCore> MakePluginCore();
+
+// Reads a "<key>: <n> kB" line of /proc/self/status, or returns -1.
+int64_t ReadProcStatusKb(const std::string& key);
+
+double ThreadCpuSeconds();
+
+}  // namespace speech_to_text_linux
+
+#endif  // SPEECH_TO_TEXT_LINUX_PLUGIN_STATE_H_
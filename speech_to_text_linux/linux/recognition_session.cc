@@ -0,0 +1,130 @@
+#include "recognition_session.h"
+
+#include <thread>
+
+#include "audio_device.h"
+
+namespace speech_to_text_linux {
+
+RecognitionSession::~RecognitionSession() {
+  if (adaptive != nullptr && adaptive->spare != nullptr && vosk->Ready()) {
+    vosk->FreeRecognizer(adaptive->spare);
+  }
+  if (standby != nullptr && standby->spotter != nullptr && vosk->Ready()) {
+    vosk->FreeRecognizer(standby->spotter);
+  }
+  if (second_pass != nullptr && second_pass->recognizer != nullptr && vosk->Ready()) {
+    vosk->FreeRecognizer(second_pass->recognizer);
+  }
+  if (pending_recognizer.valid()) {
+    // The builder notifies our waker, so let it finish first.
+    VoskRecognizer* unused = pending_recognizer.get().recognizer;
+    if (unused != nullptr && vosk->Ready()) {
+      vosk->FreeRecognizer(unused);
+    }
+  }
+  if (stream != nullptr) {
+    // Only a session torn down before it finished, e.g. with the plugin,
+    // still has its stream; nobody holds the plugin lock then.
+    std::lock_guard<std::mutex> device_lock(*device_mutex);
+    Pa_CloseStream(stream);
+    stream = nullptr;
+  }
+  if (recognizer != nullptr && vosk->Ready()) {
+    vosk->FreeRecognizer(recognizer);
+    recognizer = nullptr;
+  }
+}
+
+void RecognitionSession::ResetRecognitionTimers() {
+  listen_started = std::chrono::steady_clock::now();
+  last_speech_at = listen_started;
+  reported_speech = false;
+  speech_ended_at = listen_started;
+  session_end = SessionEnd::kStopRequested;
+  endpointer.Reset();
+  last_partial_text.clear();
+}
+
+void KeywordStandby::Remember(const int16_t* data, size_t frames) {
+  const size_t capacity = pre_roll.size();
+  if (capacity == 0) {
+    return;
+  }
+  for (size_t i = 0; i < frames; ++i) {
+    pre_roll[pre_roll_head] = data[i];
+    pre_roll_head = (pre_roll_head + 1) % capacity;
+  }
+  pre_roll_fill = std::min(capacity, pre_roll_fill + frames);
+}
+
+std::vector<int16_t> KeywordStandby::Recent(size_t max_samples) const {
+  const size_t count = std::min(max_samples, pre_roll_fill);
+  std::vector<int16_t> out(count);
+  if (count == 0) {
+    return out;
+  }
+  const size_t capacity = pre_roll.size();
+  size_t pos = (pre_roll_head + capacity - count) % capacity;
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = pre_roll[pos];
+    pos = (pos + 1) % capacity;
+  }
+  return out;
+}
+
+bool RecognitionSession::RequestStop(bool cancel, bool from_user,
+                                     std::chrono::steady_clock::time_point at) {
+  SessionPhase current = phase.load();
+  while (current == SessionPhase::kStarting || current == SessionPhase::kListening) {
+    if (phase.compare_exchange_weak(current, SessionPhase::kStopping)) {
+      // Only the winning stop writes; one that lost to the session ending
+      // on its own must not turn it into a cancel.
+      stop_requested_at = at;
+      stop_from_user = from_user;
+      if (cancel) {
+        cancel_requested.store(true);
+      }
+      stop_published.store(true, std::memory_order_release);
+      waker.Notify();
+      return true;
+    }
+  }
+  return false;
+}
+
+void RecognitionSession::AwaitStop() const {
+  while (!stop_published.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+}
+
+void RecognitionSession::MarkListening() {
+  SessionPhase starting = SessionPhase::kStarting;
+  phase.compare_exchange_strong(starting, SessionPhase::kListening);
+}
+
+bool RecognitionSession::BeginFinalizing() {
+  // A stop that lost the race against this transition is simply ignored.
+  const bool stopped = phase.exchange(SessionPhase::kFinalizing) == SessionPhase::kStopping;
+  if (stopped) {
+    AwaitStop();
+  }
+  return stopped;
+}
+
+bool RecognitionSession::capturing() const {
+  const SessionPhase current = phase.load();
+  return current == SessionPhase::kListening || current == SessionPhase::kStopping;
+}
+
+void LatencyStat::Record(double ms) {
+  count++;
+  total_ms += ms;
+  last_ms = ms;
+  if (ms > max_ms) {
+    max_ms = ms;
+  }
+}
+
+}  // namespace speech_to_text_linux
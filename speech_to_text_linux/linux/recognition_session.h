@@ -0,0 +1,528 @@
+#ifndef SPEECH_TO_TEXT_LINUX_RECOGNITION_SESSION_H_
+#define SPEECH_TO_TEXT_LINUX_RECOGNITION_SESSION_H_
+
+#include <portaudio.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "audio_capture.h"
+#include "decode_scheduler.h"
+#include "json_payloads.h"
+#include "session_output.h"
+#include "vosk_api.h"
+
+namespace speech_to_text_linux {
+
+// Feeding jumps a RecognizerClock remembers; plenty for one utterance.
+constexpr size_t kMaxClockMarks = 32;
+
+// Maps a recognizer's own clock back onto stream positions. Vosk word times
+// count every sample the recognizer was fed since it was created, so they
+// run on across Reset and pooled reuse and leave out audio it never saw,
+// such as silence skipped while catching up.
+struct RecognizerClock {
+  // Samples fed since the recognizer was created.
+  int64_t fed = 0;
+  // One past the last stream position fed; -1 before the first.
+  int64_t stream_end = -1;
+  // (fed, stream position) where each run of contiguous feeding began.
+  std::vector<std::pair<int64_t, int64_t>> marks;
+
+  void Feed(int64_t first, int64_t frames) {
+    if (first != stream_end) {
+      if (marks.size() == kMaxClockMarks) {
+        marks.erase(marks.begin());
+      }
+      marks.emplace_back(fed, first);
+    }
+    fed += frames;
+    stream_end = first + frames;
+  }
+  // Stream position, in samples, of |seconds| on the recognizer's clock.
+  double ToStream(double seconds, int sample_rate) const {
+    if (marks.empty()) {
+      return -1.0;
+    }
+    const double sample = seconds * sample_rate;
+    auto mark = marks.rbegin();
+    while (mark + 1 != marks.rend() && static_cast<double>(mark->first) > sample) {
+      ++mark;
+    }
+    return static_cast<double>(mark->second) + sample - static_cast<double>(mark->first);
+  }
+};
+
+// Aggregated timing for one latency measurement reported through `stats`.
+struct LatencyStat {
+  void Record(double ms);
+
+  int64_t count = 0;
+  double total_ms = 0.0;
+  double max_ms = 0.0;
+  double last_ms = 0.0;
+};
+
+struct DecodeCost {
+  double audio_seconds = 0.0;
+  double cpu_seconds = 0.0;
+};
+
+// How `listen` builds the recognizer relative to opening the audio device.
+enum class StartMode { kOverlapped, kSequential };
+constexpr int kStartModeCount = 2;
+
+// Why a capture session stopped reading audio.
+enum class SessionEnd {
+  kStopRequested,
+  kListenTimeout,
+  kPauseTimeout,
+  kAcousticEndpoint,
+  kVoskEndpoint,
+  kStreamError,
+};
+
+struct PipelineStats {
+  std::mutex mutex;
+  LatencyStat end_of_speech_to_final;
+  LatencyStat stop_to_status;
+  LatencyStat stop_call;
+  // Indexed by StartMode so overlapped and sequential starts can be compared.
+  LatencyStat tap_to_listening[kStartModeCount];
+  LatencyStat tap_to_first_result[kStartModeCount];
+  int64_t acoustic_endpoints = 0;
+  int64_t vosk_endpoints = 0;
+  int64_t pause_timeouts = 0;
+  int64_t listen_timeouts = 0;
+  int64_t pooled_recognizers = 0;
+  // Decode cost across all sessions, for sessions-per-core capacity.
+  double decoded_audio_seconds = 0.0;
+  double decode_cpu_seconds = 0.0;
+  // The same split by `maxAlternatives`, to price a longer N-best list.
+  std::map<int, DecodeCost> decode_cost_by_alternatives;
+  int64_t peak_active_sessions = 0;
+  // Time decode tasks wait for a worker, across all sessions.
+  LatencyStat decode_queue_delay;
+  // Chunks recognizer lanes skipped because they fell too far behind.
+  int64_t lane_dropped_chunks = 0;
+  int64_t language_picks = 0;
+  int64_t early_drops = 0;
+  // Segment end to second-pass final, and finals that fell back to the
+  // first pass because the queue was full or the budget ran out.
+  LatencyStat second_pass_latency;
+  int64_t second_pass_fallbacks = 0;
+  int64_t continuous_segments = 0;
+  // Keyword standby: wake-ups, audio listened to, the part of it the
+  // spotter decoded, and the CPU that took.
+  int64_t standby_detections = 0;
+  double standby_audio_seconds = 0.0;
+  double standby_decoded_seconds = 0.0;
+  double standby_cpu_seconds = 0.0;
+  // Adaptive decoding steps down under CPU pressure and back up.
+  int64_t downgrades = 0;
+  int64_t restores = 0;
+  // Catch-up mode: how often sessions fell behind, the deepest backlog,
+  // silence skipped to catch up, and audio lost to a full ring.
+  int64_t catch_up_events = 0;
+  double peak_backlog_ms = 0.0;
+  double catch_up_skipped_seconds = 0.0;
+  double overflow_seconds = 0.0;
+  // Allocations the hot path could not avoid: chunks and control blocks
+  // the pools had to create.
+  int64_t chunk_pool_misses = 0;
+  // Plugin work on the platform thread (dispatching calls, sending events
+  // and responses) against the control worker that runs the calls.
+  double main_thread_cpu_seconds = 0.0;
+  double control_cpu_seconds = 0.0;
+  LatencyStat control_queue_delay;
+  // How long device calls waited for the background Pa_Initialize.
+  LatencyStat port_audio_wait;
+  // Start-up: time spent in plugin registration and from registration to
+  // the first recognition result. The background tasks report their own.
+  double registration_ms = 0.0;
+  double first_recognition_ms = 0.0;
+};
+
+class RecognitionSession;
+
+// An additional recognizer listening to a session's capture, for example a
+// command grammar next to dictation or a second language. Each lane decodes
+// its chunks in order on its own tasks and tags results with |name|.
+struct RecognizerLane {
+  RecognitionSession* session = nullptr;
+  std::string name;
+  VoskModel* model = nullptr;
+  RecognizerOptions options;
+  VoskRecognizer* recognizer = nullptr;
+  // Built while `listen` opens the device; taken before capture starts.
+  std::future<VoskRecognizer*> pending_recognizer;
+  RecognizerClock clock;
+  std::string last_partial_text;
+
+  std::mutex mutex;
+  RingQueue<AudioChunkRef> chunks;
+  std::string partial_scratch;
+  // Set once the session stopped capturing; guarded by |mutex|.
+  bool input_closed = false;
+  uint64_t dropped_chunks = 0;
+
+  std::atomic<bool> decode_scheduled{false};
+  std::atomic<bool> decode_pending{false};
+  std::chrono::steady_clock::time_point decode_enqueued_at;
+
+  // Position in the session's LanguageRace, and whether it lost. A lane
+  // that lost in a continuous session idles until the race reopens and then
+  // starts over from |reset_pending|.
+  int race_index = 0;
+  std::atomic<bool> dropped{false};
+  std::atomic<bool> reset_pending{false};
+  // Stream positions behind the lane's current utterance; see
+  // RecognitionSession::utterance_start.
+  int64_t utterance_start = -1;
+  int64_t utterance_end = 0;
+};
+
+// Chunks a lane may fall behind before new audio is dropped for it.
+constexpr size_t kMaxLaneBacklogChunks = 64;
+
+struct RaceCandidate {
+  std::string name;
+  int64_t words = 0;
+  double confidence_sum = 0.0;
+  // Finals held back until the candidate is picked, the audio they cover
+  // and, when sent or journaled, their words.
+  std::string held_text;
+  AudioSpan held_span;
+  std::vector<WordTiming> held_words;
+  bool dropped = false;
+
+  double score() const { return words > 0 ? confidence_sum / words : -1.0; }
+};
+
+// Picks one of several recognizers, typically one model per language, by
+// the word confidence of their finals. A candidate trailing the leader by
+// |margin| once the leader has |min_words| words stops decoding. Until one
+// candidate is left, finals are held back and only the leader's partials
+// are shown; after that the winner streams directly. Continuous sessions
+// reopen the race at every segment boundary, so each utterance gets its own
+// pick.
+struct LanguageRace {
+  std::mutex mutex;
+  // Index 0 is the session's own recognizer, then its lanes in order.
+  std::vector<RaceCandidate> candidates;
+  double margin = 0.15;
+  int64_t min_words = 3;
+  int leader = 0;
+  int winner = -1;
+  // The previous utterance's pick and where the current one began, for
+  // finals of lagging lanes that still belong to the previous utterance.
+  int previous_winner = -1;
+  double opened_ms = -1.0;
+};
+
+// An endpointed segment waiting for the second pass, with the first-pass
+// final to fall back to.
+struct SecondPassJob {
+  std::vector<AudioChunkRef> chunks;
+  // Set for a segment the second pass has no room for: the job only sends
+  // the first-pass final, in order with the segments queued before it.
+  bool fallback_only = false;
+  std::string fallback_text;
+  double fallback_confidence = -1.0;
+  // The first-pass words on the session's timeline, when sent or journaled.
+  std::vector<WordTiming> fallback_words;
+  AudioSpan span;
+  // When the segment's speech ended, for the journal; unset without speech.
+  std::chrono::steady_clock::time_point speech_ended_at;
+  bool overflowed = false;
+  std::chrono::steady_clock::time_point queued_at;
+  std::chrono::steady_clock::time_point deadline;
+};
+
+// Two-pass mode: the session's own (small) recognizer drives partials and
+// each of its finals is re-decoded by a larger model. Jobs of one session
+// run one at a time, in order.
+struct SecondPass {
+  VoskModel* model = nullptr;
+  VoskRecognizer* recognizer = nullptr;
+  // Built while `listen` opens the device, like lane recognizers.
+  std::future<VoskRecognizer*> pending_recognizer;
+  // Touched only by the pass's tasks, which run one at a time.
+  RecognizerClock clock;
+  size_t max_queue = 2;
+  std::chrono::milliseconds budget{1500};
+
+  std::mutex mutex;
+  std::deque<SecondPassJob> jobs;
+  // Jobs in |jobs| that carry audio; fallback-only jobs do not count
+  // against |max_queue|.
+  size_t audio_jobs = 0;
+  bool scheduled = false;
+};
+
+// Adaptive decoding: when the session's real-time factor stays above
+// |rtf_high| for |hold|, it steps down one level; below |rtf_low| for |hold|
+// it steps back up. Level 1 turns off partial words, level 2 (only with a
+// light model) decodes new segments with the light model. Touched only by
+// the session's decode task.
+struct AdaptiveDecoding {
+  VoskModel* light_model = nullptr;
+  RecognizerOptions options;
+  double rtf_high = 0.8;
+  double rtf_low = 0.5;
+  std::chrono::milliseconds hold{2000};
+  int level = 0;
+  // Model switches wait for a segment boundary; |spare| is the recognizer
+  // not in use, kept so switching back does not rebuild it.
+  bool use_light = false;
+  VoskRecognizer* spare = nullptr;
+  RecognizerClock spare_clock;
+  bool pressure_changed = false;
+  std::chrono::steady_clock::time_point pressure_since;
+  int pressure = 0;
+
+  int max_level() const { return light_model != nullptr ? 2 : 1; }
+};
+
+// Catch-up mode starts once this much audio waits in the ring and ends when
+// the backlog drops below the exit mark. While catching up, tasks take
+// bigger slices in batches of up to kCatchUpBatchMillis, and silence more
+// than kCatchUpKeepSilenceMillis past the last voice may be skipped; the
+// kept part still lets Vosk close the utterance.
+constexpr int kCatchUpEnterMillis = 500;
+constexpr int kCatchUpExitMillis = 100;
+constexpr int kCatchUpSliceMillis = 500;
+constexpr int kCatchUpBatchMillis = 250;
+constexpr int kCatchUpKeepSilenceMillis = 500;
+
+enum class SessionPhase { kIdle, kStarting, kListening, kStopping, kFinalizing };
+
+// Keyword standby: until one of |keywords| is heard, only a small grammar
+// recognizer runs, and only on audio the energy endpointer considers voiced.
+// The last |pre_roll| samples are kept so the full recognizer hears the
+// keyword and whatever followed it. Touched only by the session's decode task.
+struct KeywordStandby {
+  std::vector<std::string> keywords;
+  std::string grammar;
+  std::string scratch;
+  VoskRecognizer* spotter = nullptr;
+  bool gate_open = false;
+  // Ring of the most recent audio; |pre_roll_fill| samples of it are valid.
+  std::vector<int16_t> pre_roll;
+  size_t pre_roll_head = 0;
+  size_t pre_roll_fill = 0;
+  // `listenFor` starts counting once the keyword is heard.
+  std::chrono::milliseconds listen_timeout{0};
+  int64_t heard_samples = 0;
+  int64_t gated_samples = 0;
+  double cpu_seconds = 0.0;
+
+  void Remember(const int16_t* data, size_t frames);
+  // Copies the newest |max_samples| remembered samples, oldest first.
+  std::vector<int16_t> Recent(size_t max_samples) const;
+};
+
+// Voiced audio before the endpointer opens the gate that the spotter still
+// gets, and how long the gate stays open after the voice stops.
+constexpr int kStandbyLookbackMillis = 300;
+constexpr int kStandbyHangoverMillis = 300;
+
+// Longest segment kept for the second pass; longer ones use the first-pass
+// final so a session without endpoints cannot grow without bound.
+constexpr int kMaxSecondPassSegmentSeconds = 30;
+
+// One listen session: its stream, capture ring and recognizer. Its audio is
+// decoded by tasks on the shared DecodeScheduler, at most one at a time, so
+// chunks are processed in capture order. A session outlives `stop` so that
+// the next `listen` can start while the previous one is still finalizing.
+class RecognitionSession {
+ public:
+  RecognitionSession(int64_t session_id, const VoskApi* vosk_api,
+                     std::shared_ptr<std::mutex> device_mutex_in)
+      : id(session_id), vosk(vosk_api), device_mutex(std::move(device_mutex_in)) {
+    stream_closed_future = stream_closed.get_future().share();
+  }
+  ~RecognitionSession();
+
+  void ResetRecognitionTimers();
+
+  const int64_t id;
+  const VoskApi* const vosk;
+  // The plugin's |device_mutex|, for closing a stream no decode task closed.
+  const std::shared_ptr<std::mutex> device_mutex;
+  // Tags results of the session's own recognizer when lanes run beside it.
+  std::string recognizer_name = "default";
+  std::vector<std::unique_ptr<RecognizerLane>> lanes;
+  // Recognizers still to deliver their final result, the session's own
+  // included. The one that brings it to zero completes the session.
+  std::atomic<int> open_recognizers{1};
+  std::atomic<bool> lane_reported_speech{false};
+  // Set when the session picks between its recognizers; `dropped` is set
+  // once its own recognizer lost.
+  std::unique_ptr<LanguageRace> race;
+  std::atomic<bool> dropped{false};
+  // Two-pass mode; |segment| holds the audio since the last first-pass
+  // final. Only the session's decode task touches the segment fields.
+  std::unique_ptr<SecondPass> second_pass;
+  std::vector<AudioChunkRef> segment;
+  int64_t segment_samples = 0;
+  bool segment_overflowed = false;
+
+  // Decode wall time over audio duration, smoothed per slice, and the
+  // adaptive decoding state driven by it.
+  std::atomic<double> real_time_factor{0.0};
+  std::atomic<int> decode_level{0};
+  std::unique_ptr<AdaptiveDecoding> adaptive;
+
+  // Set while waiting for a keyword; cleared when the session wakes up.
+  std::unique_ptr<KeywordStandby> standby;
+
+  // Opt-in recording of everything read from |ring| (`recordDirectory`).
+  std::shared_ptr<RecordingSink> recording;
+  // Opt-in journal of finals (`transcriptJournalPath`), owned by the state.
+  TranscriptJournal* journal = nullptr;
+
+  // Continuous dictation: endpoints close a segment instead of the session,
+  // and the recognizer is reset in place after every segment final.
+  bool continuous = false;
+  int64_t segments = 0;
+
+  // Grammar posted by `setGrammar`, applied at the next utterance boundary.
+  std::mutex grammar_mutex;
+  std::string pending_grammar;
+  std::atomic<bool> grammar_changed{false};
+  // The `createSession` handle this session was started through, or 0.
+  // Handle sessions never use the legacy callbacks.
+  int64_t handle_id = 0;
+
+  bool partial_results_enabled = true;
+  // Send `textRecognitionWords` along with every final (`wordTimings`).
+  bool word_timings = false;
+  // Send `textRecognitionSpan` along with every result that has a known
+  // audio span (`audioSpans`).
+  bool audio_spans = false;
+  // Finals carry this many alternates (`maxAlternatives`); 0 sends one.
+  int max_alternatives = 0;
+  int sample_rate = 16000;
+  unsigned long frames_per_buffer = 1024;
+  std::string last_partial_text;
+  std::string partial_scratch;
+
+  std::chrono::milliseconds listen_timeout{0};
+  std::chrono::milliseconds pause_timeout{0};
+  std::chrono::steady_clock::time_point listen_started;
+  std::chrono::steady_clock::time_point last_speech_at;
+  bool reported_speech = false;
+
+  // Acoustic endpointing; `endpoint_on_vosk_result` ends the session on the
+  // first utterance boundary reported by Vosk's own endpointer.
+  EnergyEndpointer endpointer;
+  bool endpoint_enabled = false;
+  bool endpoint_on_vosk_result = false;
+  bool wants_vosk_endpointer = false;
+  std::chrono::steady_clock::time_point speech_ended_at;
+  SessionEnd session_end = SessionEnd::kStopRequested;
+
+  // Set when `listen` is called; the recognizer may still be under
+  // construction on a worker while the stream is already capturing.
+  std::chrono::steady_clock::time_point tapped_at;
+  StartMode start_mode = StartMode::kOverlapped;
+  bool first_result_recorded = false;
+  std::future<RecognizerSetup> pending_recognizer;
+  int64_t decoded_samples = 0;
+  // Stream clock for result timestamps: CLOCK_MONOTONIC nanoseconds of
+  // stream position 0 (0 until the first capture callback), and the stream
+  // position the decode side has read up to. Positions count every sample
+  // the device delivered, dropped ones included. The capture callback
+  // re-anchors the origin every kStreamAnchorSeconds of audio, so device
+  // clock drift does not build up; |stream_captured| and |next_anchor| are
+  // its own.
+  std::atomic<int64_t> stream_origin_ns{0};
+  int64_t stream_read = 0;
+  int64_t stream_captured = 0;
+  int64_t next_anchor = 0;
+  // Stream positions of the audio behind the recognizer's current
+  // utterance: its first sample (-1 until audio is fed) and one past the
+  // last sample fed.
+  int64_t utterance_start = -1;
+  int64_t utterance_end = 0;
+  // Word-time clock of |recognizer|, swapped along with it.
+  RecognizerClock clock;
+
+  // Decode task bookkeeping. `decode_pending` records a wake-up that arrived
+  // while a task was already queued or running.
+  std::atomic<bool> decode_scheduled{false};
+  std::atomic<bool> decode_pending{false};
+  std::chrono::steady_clock::time_point decode_enqueued_at;
+  double task_cpu_started = 0.0;
+  double decode_cpu_seconds = 0.0;
+  std::vector<int16_t> decode_buffer;
+  ChunkPool chunk_pool;
+  // Catch-up mode, entered when the ring backs up: larger batches, no
+  // partial polling and, with |drop_silence_when_behind|, no decoding of
+  // long silence.
+  bool catching_up = false;
+  bool drop_silence_when_behind = false;
+  int64_t skipped_samples = 0;
+  std::atomic<int64_t> backlog_samples{0};
+  // Guarded by PipelineStats::mutex.
+  LatencyStat queue_delay;
+
+  PaStream* stream = nullptr;
+  std::unique_ptr<AudioRing> ring;
+  CaptureWaker waker;
+  VoskModel* model = nullptr;
+  VoskRecognizer* recognizer = nullptr;
+  // Whether the recognizer may be reset and reused by a later session.
+  bool poolable = false;
+
+  // Lifecycle, advanced by compare-and-swap so control calls never wait for
+  // the decode side:
+  //   kIdle -> kStarting   `listen` builds the session and opens the device
+  //         -> kListening  the stream runs
+  //         -> kStopping   `stop`/`cancel`; the decode task winds down
+  //         -> kFinalizing the stream is closed, final results are pending
+  //         -> kIdle       every recognizer finished; nothing touches the
+  //                        session after that.
+  // A session that ends on its own goes from kListening to kFinalizing.
+  std::atomic<SessionPhase> phase{SessionPhase::kIdle};
+  std::atomic<bool> cancel_requested{false};
+  // Written by the stop that moved the phase to kStopping, right after it
+  // did, then published through |stop_published|; see AwaitStop.
+  std::chrono::steady_clock::time_point stop_requested_at;
+  bool stop_from_user = false;
+  std::atomic<bool> stop_published{false};
+  std::promise<void> stream_closed;
+  std::shared_future<void> stream_closed_future;
+
+  // Moves a starting or listening session to kStopping. Returns false when
+  // it is already stopping or past that.
+  bool RequestStop(bool cancel, bool from_user, std::chrono::steady_clock::time_point at);
+  // For whoever observed kStopping: waits the few instructions until the
+  // stop's details, including a cancel, are written.
+  void AwaitStop() const;
+  // Moves a starting session to kListening once its stream runs. A stop
+  // during the open wins: the session stays in kStopping.
+  void MarkListening();
+  // Moves the session to kFinalizing once its stream is closed. Returns
+  // whether a stop got there first; its details are then readable.
+  bool BeginFinalizing();
+  // Whether the stream is open, in kListening or kStopping.
+  bool capturing() const;
+  bool stopping() const { return phase.load() == SessionPhase::kStopping; }
+  // Only meaningful once the session was started.
+  bool finished() const { return phase.load() == SessionPhase::kIdle; }
+};
+
+}  // namespace speech_to_text_linux
+
+#endif  // SPEECH_TO_TEXT_LINUX_RECOGNITION_SESSION_H_
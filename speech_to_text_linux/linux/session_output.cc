@@ -0,0 +1,284 @@
+#include "session_output.h"
+
+#include <fcntl.h>
+#include <glib.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+
+namespace speech_to_text_linux {
+
+static void FillWavHeader(uint8_t* header, int sample_rate, int64_t data_bytes) {
+  auto put = [header](size_t at, uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+      header[at + i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+  };
+  const uint32_t data_size = static_cast<uint32_t>(
+      std::min<int64_t>(data_bytes, UINT32_MAX - kWavHeaderBytes));
+  memcpy(header, "RIFF", 4);
+  put(4, data_size + kWavHeaderBytes - 8, 4);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  put(16, 16, 4);                                          // fmt chunk size
+  put(20, 1, 2);                                           // PCM
+  put(22, 1, 2);                                           // mono
+  put(24, static_cast<uint32_t>(sample_rate), 4);
+  put(28, static_cast<uint32_t>(sample_rate) * 2, 4);      // byte rate
+  put(32, 2, 2);                                           // block align
+  put(34, 16, 2);                                          // bits per sample
+  memcpy(header + 36, "data", 4);
+  put(40, data_size, 4);
+}
+
+static bool WriteAll(int fd, const void* data, size_t bytes) {
+  const char* cursor = static_cast<const char*>(data);
+  while (bytes > 0) {
+    const ssize_t written = write(fd, cursor, bytes);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    cursor += written;
+    bytes -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+SessionRecorder::SessionRecorder() : batch_(32768), thread_([this]() { Run(); }) {}
+
+SessionRecorder::~SessionRecorder() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+void SessionRecorder::Add(std::shared_ptr<RecordingSink> sink) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  sinks_.push_back(std::move(sink));
+}
+
+void SessionRecorder::Append(RecordingSink* sink, const int16_t* data, size_t frames) {
+  sink->ring.Write(data, frames);
+  // Normally the periodic flush keeps the ring nearly empty.
+  if (sink->ring.Available() * 2 > sink->ring.capacity()) {
+    Wake();
+  }
+}
+
+void SessionRecorder::Close(RecordingSink* sink) {
+  sink->closed.store(true);
+  Wake();
+}
+
+void SessionRecorder::Wake() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wake_ = true;
+  }
+  cv_.notify_one();
+}
+
+void SessionRecorder::Run() {
+  std::vector<std::shared_ptr<RecordingSink>> sinks;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait_for(lock, std::chrono::milliseconds(kRecorderFlushMillis),
+                 [this]() { return wake_ || stopping_; });
+    wake_ = false;
+    const bool stopping = stopping_;
+    sinks = sinks_;
+    lock.unlock();
+
+    int64_t queued_ms = 0;
+    for (const auto& sink : sinks) {
+      queued_ms += static_cast<int64_t>(sink->ring.Available()) * 1000 / sink->sample_rate;
+    }
+    queued_ms_.store(queued_ms);
+    if (queued_ms > peak_queued_ms_.load()) {
+      peak_queued_ms_.store(queued_ms);
+    }
+    for (const auto& sink : sinks) {
+      // Read before draining: every sample queued before the flag was
+      // raised is then written below.
+      const bool closing = sink->closed.load() || stopping;
+      Drain(sink.get());
+      if (closing) {
+        CloseFile(sink.get());
+        dropped_ms_.fetch_add(static_cast<int64_t>(sink->ring.dropped_samples()) * 1000 /
+                              sink->sample_rate);
+        sink->done = true;
+      }
+    }
+    sinks.clear();
+
+    lock.lock();
+    sinks_.erase(std::remove_if(sinks_.begin(), sinks_.end(),
+                                [](const std::shared_ptr<RecordingSink>& sink) {
+                                  return sink->done;
+                                }),
+                 sinks_.end());
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+void SessionRecorder::Drain(RecordingSink* sink) {
+  size_t frames = 0;
+  while ((frames = sink->ring.Read(batch_.data(), batch_.size())) > 0) {
+    size_t offset = 0;
+    while (offset < frames && !sink->failed) {
+      if (sink->fd < 0 && !OpenFile(sink)) {
+        break;
+      }
+      size_t take = frames - offset;
+      if (sink->max_file_samples > 0) {
+        take = std::min<size_t>(take,
+                                static_cast<size_t>(sink->max_file_samples - sink->file_samples));
+      }
+      if (!WriteAll(sink->fd, batch_.data() + offset, take * sizeof(int16_t))) {
+        g_warning("speech_to_text_linux: writing %s-%d.wav failed: %s", sink->prefix.c_str(),
+                  sink->file_index, strerror(errno));
+        errors_.fetch_add(1);
+        CloseFile(sink);
+        sink->failed = true;
+        break;
+      }
+      offset += take;
+      sink->file_samples += static_cast<int64_t>(take);
+      bytes_written_.fetch_add(static_cast<int64_t>(take * sizeof(int16_t)));
+      if (sink->max_file_samples > 0 && sink->file_samples >= sink->max_file_samples) {
+        CloseFile(sink);
+      }
+    }
+  }
+}
+
+bool SessionRecorder::OpenFile(RecordingSink* sink) {
+  const std::string path = sink->prefix + "-" + std::to_string(++sink->file_index) + ".wav";
+  sink->fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  uint8_t header[kWavHeaderBytes];
+  // Sizes are patched in when the file is closed.
+  FillWavHeader(header, sink->sample_rate, 0);
+  if (sink->fd < 0 || !WriteAll(sink->fd, header, sizeof(header))) {
+    g_warning("speech_to_text_linux: cannot record to %s: %s", path.c_str(), strerror(errno));
+    if (sink->fd >= 0) {
+      close(sink->fd);
+      sink->fd = -1;
+    }
+    errors_.fetch_add(1);
+    sink->failed = true;
+    return false;
+  }
+  sink->file_samples = 0;
+  files_.fetch_add(1);
+  bytes_written_.fetch_add(static_cast<int64_t>(sizeof(header)));
+  return true;
+}
+
+void SessionRecorder::CloseFile(RecordingSink* sink) {
+  if (sink->fd < 0) {
+    return;
+  }
+  uint8_t header[kWavHeaderBytes];
+  FillWavHeader(header, sink->sample_rate,
+                sink->file_samples * static_cast<int64_t>(sizeof(int16_t)));
+  if (pwrite(sink->fd, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+    errors_.fetch_add(1);
+  }
+  close(sink->fd);
+  sink->fd = -1;
+}
+
+TranscriptJournal::TranscriptJournal(const std::string& path, SyncPolicy policy,
+                                     std::chrono::milliseconds interval)
+    : path_(path), policy_(policy), interval_(interval) {
+  fd_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    g_warning("speech_to_text_linux: cannot open transcript journal %s: %s", path_.c_str(),
+              strerror(errno));
+    errors_.fetch_add(1);
+  }
+  thread_ = std::thread([this]() { Run(); });
+}
+
+TranscriptJournal::~TranscriptJournal() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+void TranscriptJournal::Append(std::string line) {
+  line.push_back('\n');
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back(std::move(line));
+  }
+  cv_.notify_one();
+}
+
+void TranscriptJournal::Run() {
+  std::vector<std::string> batch;
+  std::string buffer;
+  bool dirty = false;
+  auto last_sync = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (policy_ == SyncPolicy::kInterval && dirty) {
+      cv_.wait_until(lock, last_sync + interval_,
+                     [this]() { return stopping_ || !pending_.empty(); });
+    } else {
+      cv_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+    }
+    const bool stopping = stopping_;
+    batch.swap(pending_);
+    lock.unlock();
+
+    buffer.clear();
+    for (const auto& line : batch) {
+      buffer.append(line);
+    }
+    if (!buffer.empty() && fd_ >= 0) {
+      if (WriteAll(fd_, buffer.data(), buffer.size())) {
+        lines_written_.fetch_add(static_cast<int64_t>(batch.size()));
+        bytes_written_.fetch_add(static_cast<int64_t>(buffer.size()));
+        dirty = true;
+      } else {
+        errors_.fetch_add(1);
+      }
+    }
+    batch.clear();
+    const auto now = std::chrono::steady_clock::now();
+    const bool sync_due = policy_ == SyncPolicy::kBatch ||
+                          (policy_ == SyncPolicy::kInterval &&
+                           (now - last_sync >= interval_ || stopping));
+    if (dirty && sync_due && policy_ != SyncPolicy::kNever) {
+      if (fdatasync(fd_) != 0) {
+        errors_.fetch_add(1);
+      }
+      syncs_.fetch_add(1);
+      last_sync = now;
+      dirty = false;
+    }
+
+    lock.lock();
+    if (stopping && pending_.empty()) {
+      return;
+    }
+  }
+}
+
+}  // namespace speech_to_text_linux
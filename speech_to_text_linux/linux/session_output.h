@@ -0,0 +1,135 @@
+#ifndef SPEECH_TO_TEXT_LINUX_SESSION_OUTPUT_H_
+#define SPEECH_TO_TEXT_LINUX_SESSION_OUTPUT_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio_capture.h"
+
+namespace speech_to_text_linux {
+
+// Append-only JSONL file of final results. Decode tasks only queue lines;
+// a background thread writes whatever has queued in one batch and syncs the
+// file according to the policy.
+class TranscriptJournal {
+ public:
+  enum class SyncPolicy { kNever, kBatch, kInterval };
+
+  TranscriptJournal(const std::string& path, SyncPolicy policy,
+                    std::chrono::milliseconds interval);
+  // Writes the remaining lines, syncs and closes the file.
+  ~TranscriptJournal();
+  TranscriptJournal(const TranscriptJournal&) = delete;
+  TranscriptJournal& operator=(const TranscriptJournal&) = delete;
+
+  // |line| without the trailing newline.
+  void Append(std::string line);
+
+  int64_t lines_written() const { return lines_written_.load(); }
+  int64_t bytes_written() const { return bytes_written_.load(); }
+  int64_t syncs() const { return syncs_.load(); }
+  int64_t errors() const { return errors_.load(); }
+
+ private:
+  void Run();
+
+  const std::string path_;
+  const SyncPolicy policy_;
+  const std::chrono::milliseconds interval_;
+  int fd_ = -1;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::string> pending_;
+  bool stopping_ = false;
+  std::atomic<int64_t> lines_written_{0};
+  std::atomic<int64_t> bytes_written_{0};
+  std::atomic<int64_t> syncs_{0};
+  std::atomic<int64_t> errors_{0};
+  std::thread thread_;
+};
+
+// How often the recording writer flushes queued audio to disk.
+constexpr int kRecorderFlushMillis = 250;
+constexpr size_t kWavHeaderBytes = 44;
+
+// Audio of one recorded session, on its way to WAV files. The decode task
+// only copies samples into |ring|; everything else belongs to the writer.
+struct RecordingSink {
+  explicit RecordingSink(size_t ring_samples) : ring(ring_samples) {}
+
+  AudioRing ring;
+  // Raised after the session's last sample was queued.
+  std::atomic<bool> closed{false};
+
+  // Fixed when the session starts. Files are named `<prefix>-<n>.wav`.
+  std::string prefix;
+  int sample_rate = 16000;
+  // Samples per file before rotating to the next one; 0 for no limit.
+  int64_t max_file_samples = 0;
+
+  // Writer thread only.
+  int fd = -1;
+  int file_index = 0;
+  int64_t file_samples = 0;
+  bool failed = false;
+  bool done = false;
+};
+
+// Background writer for session recordings. It wakes every
+// kRecorderFlushMillis and writes each sink's queued audio in one batch, so
+// disk latency never reaches capture or decoding.
+class SessionRecorder {
+ public:
+  SessionRecorder();
+  // Writes out what is queued and closes every file.
+  ~SessionRecorder();
+  SessionRecorder(const SessionRecorder&) = delete;
+  SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+  void Add(std::shared_ptr<RecordingSink> sink);
+  // Decode side; never blocks. Audio that finds the ring full is dropped
+  // and counted.
+  void Append(RecordingSink* sink, const int16_t* data, size_t frames);
+  void Close(RecordingSink* sink);
+
+  int64_t bytes_written() const { return bytes_written_.load(); }
+  int64_t files() const { return files_.load(); }
+  int64_t errors() const { return errors_.load(); }
+  // Audio waiting for the writer across all sinks, as of its last pass.
+  int64_t queued_ms() const { return queued_ms_.load(); }
+  int64_t peak_queued_ms() const { return peak_queued_ms_.load(); }
+  int64_t dropped_ms() const { return dropped_ms_.load(); }
+
+ private:
+  void Run();
+  void Wake();
+  void Drain(RecordingSink* sink);
+  bool OpenFile(RecordingSink* sink);
+  void CloseFile(RecordingSink* sink);
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::shared_ptr<RecordingSink>> sinks_;
+  bool wake_ = false;
+  bool stopping_ = false;
+  // Writer thread only.
+  std::vector<int16_t> batch_;
+  std::atomic<int64_t> bytes_written_{0};
+  std::atomic<int64_t> files_{0};
+  std::atomic<int64_t> errors_{0};
+  std::atomic<int64_t> queued_ms_{0};
+  std::atomic<int64_t> peak_queued_ms_{0};
+  std::atomic<int64_t> dropped_ms_{0};
+  std::thread thread_;
+};
+
+}  // namespace speech_to_text_linux
+
+#endif  // SPEECH_TO_TEXT_LINUX_SESSION_OUTPUT_H_
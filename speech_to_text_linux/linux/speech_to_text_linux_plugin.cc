@@ -1,564 +1,57 @@
 #include "include/speech_to_text_linux/speech_to_text_linux_plugin.h"
 
 #include <flutter_linux/flutter_linux.h>
-#include <portaudio.h>
 
-#include <atomic>
-#include <chrono>
-#include <cmath>
-#include <cstdint>
+#include <algorithm>
 #include <cctype>
-#include <dlfcn.h>
+#include <chrono>
+#include <cstring>
 #include <future>
-#include <glib.h>
-#include <iomanip>
 #include <memory>
 #include <mutex>
 #include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
-#include <algorithm>
+
+#include "audio_device.h"
+#include "decode_pipeline.h"
+#include "json_payloads.h"
+#include "plugin_state.h"
 
 #define SPEECH_TO_TEXT_LINUX_PLUGIN(obj) \
   (G_TYPE_CHECK_INSTANCE_CAST((obj), speech_to_text_linux_plugin_get_type(), \
                               SpeechToTextLinuxPlugin))
 
-namespace {
-
-constexpr int kPartialResult = 0;
-constexpr int kFinalResult = 2;
-
-struct VoskModel;
-struct VoskRecognizer;
-
-struct StreamOpenResult {
-  PaError error;
-  PaStream* stream;
-  bool timed_out;
-};
-
-class VoskApi {
- public:
-  bool Load(const std::string& custom_path);
-  void Unload();
-  bool Ready() const { return handle_ != nullptr; }
-  std::string last_error() const { return last_error_; }
-
-  VoskModel* NewModel(const std::string& path) const;
-  void FreeModel(VoskModel* model) const;
-
-  VoskRecognizer* NewRecognizer(VoskModel* model, float sample_rate) const;
-  void FreeRecognizer(VoskRecognizer* recognizer) const;
-  int AcceptWaveform(VoskRecognizer* recognizer, const int16_t* data, int frames) const;
-  std::string Result(VoskRecognizer* recognizer) const;
-  std::string PartialResult(VoskRecognizer* recognizer) const;
-  std::string FinalResult(VoskRecognizer* recognizer) const;
-  void Reset(VoskRecognizer* recognizer) const;
-  void EnableWordTimings(VoskRecognizer* recognizer) const;
-  void EnablePartialWords(VoskRecognizer* recognizer, bool enabled) const;
-  void ConfigureLogging(bool debug) const;
-
- private:
-  void* handle_ = nullptr;
-  mutable std::string last_error_;
-
-  using ModelNewFn = VoskModel* (*)(const char*);
-  using ModelFreeFn = void (*)(VoskModel*);
-  using RecognizerNewFn = VoskRecognizer* (*)(VoskModel*, float);
-  using RecognizerFreeFn = void (*)(VoskRecognizer*);
-  using RecognizerAcceptFn = int (*)(VoskRecognizer*, const char*, int);
-  using RecognizerResultFn = const char* (*)(VoskRecognizer*);
-  using RecognizerResetFn = void (*)(VoskRecognizer*);
-  using RecognizerSetIntFn = void (*)(VoskRecognizer*, int);
-  using SetLogLevelFn = void (*)(int);
-
-  ModelNewFn model_new_ = nullptr;
-  ModelFreeFn model_free_ = nullptr;
-  RecognizerNewFn recognizer_new_ = nullptr;
-  RecognizerFreeFn recognizer_free_ = nullptr;
-  RecognizerAcceptFn recognizer_accept_ = nullptr;
-  RecognizerResultFn recognizer_result_ = nullptr;
-  RecognizerResultFn recognizer_partial_ = nullptr;
-  RecognizerResultFn recognizer_final_ = nullptr;
-  RecognizerResetFn recognizer_reset_ = nullptr;
-  RecognizerSetIntFn recognizer_set_words_ = nullptr;
-  RecognizerSetIntFn recognizer_set_partial_words_ = nullptr;
-  SetLogLevelFn set_log_level_ = nullptr;
-};
-
-class SpeechToTextLinuxPluginState {
- public:
-  SpeechToTextLinuxPluginState() = default;
-  ~SpeechToTextLinuxPluginState();
-
-  void ResetRecognitionTimers();
-  void JoinCaptureThread();
-
-  std::mutex mutex;
-  bool debug_logging = false;
-  bool initialized = false;
-  bool listening = false;
-  bool partial_results_enabled = true;
-  bool pa_initialized = false;
-
-  int sample_rate = 16000;
-  unsigned long frames_per_buffer = 1024;
-  std::string model_path;
-  std::string locale_tag = "en-US";
-  std::string locale_label = "en-US:en-US (Vosk)";
-  std::string last_partial_text;
-
-  std::chrono::milliseconds listen_timeout{0};
-  std::chrono::milliseconds pause_timeout{0};
-  std::chrono::steady_clock::time_point listen_started;
-  std::chrono::steady_clock::time_point last_speech_at;
-  bool reported_speech = false;
-
-  PaStream* stream = nullptr;
-  VoskModel* model = nullptr;
-  VoskRecognizer* recognizer = nullptr;
-  VoskApi vosk;
-
-  std::atomic<bool> stop_requested{false};
-  std::atomic<bool> cancel_requested{false};
-
-  std::thread capture_thread;
-  bool capture_thread_running = false;
-};
-
-SpeechToTextLinuxPluginState::~SpeechToTextLinuxPluginState() {
-  stop_requested.store(true);
-  JoinCaptureThread();
-  if (stream != nullptr) {
-    Pa_CloseStream(stream);
-    stream = nullptr;
-  }
-  if (recognizer != nullptr && vosk.Ready()) {
-    vosk.FreeRecognizer(recognizer);
-    recognizer = nullptr;
-  }
-  if (model != nullptr && vosk.Ready()) {
-    vosk.FreeModel(model);
-    model = nullptr;
-  }
-  if (pa_initialized) {
-    Pa_Terminate();
-    pa_initialized = false;
-  }
-  vosk.Unload();
-}
-
-void SpeechToTextLinuxPluginState::JoinCaptureThread() {
-  if (capture_thread_running && capture_thread.joinable()) {
-    capture_thread.join();
-  }
-  capture_thread_running = false;
-}
-
-void SpeechToTextLinuxPluginState::ResetRecognitionTimers() {
-  listen_started = std::chrono::steady_clock::now();
-  last_speech_at = listen_started;
-  reported_speech = false;
-  last_partial_text.clear();
-  stop_requested.store(false);
-  cancel_requested.store(false);
-}
-
-bool VoskApi::Load(const std::string& custom_path) {
-  if (handle_ != nullptr) {
-    return true;
-  }
-  std::vector<std::string> candidates;
-  if (!custom_path.empty()) {
-    candidates.push_back(custom_path);
-  }
-  candidates.emplace_back("libvosk.so");
-  candidates.emplace_back("libvosk.so.1");
-
-  for (const auto& candidate : candidates) {
-    handle_ = dlopen(candidate.c_str(), RTLD_LAZY | RTLD_LOCAL);
-    if (handle_ != nullptr) {
-      break;
-    }
-  }
-
-  if (handle_ == nullptr) {
-    const char* error = dlerror();
-    last_error_ = error != nullptr ? error : "Unable to load libvosk";
-    return false;
-  }
-
-#define LOAD_VOSK_SYMBOL(field, symbol)                                              \
-  field = reinterpret_cast<decltype(field)>(dlsym(handle_, symbol));                \
-  if (field == nullptr) {                                                            \
-    last_error_ = std::string("Missing symbol from libvosk: ") + symbol;          \
-    Unload();                                                                        \
-    return false;                                                                    \
-  }
-
-  LOAD_VOSK_SYMBOL(model_new_, "vosk_model_new");
-  LOAD_VOSK_SYMBOL(model_free_, "vosk_model_free");
-  LOAD_VOSK_SYMBOL(recognizer_new_, "vosk_recognizer_new");
-  LOAD_VOSK_SYMBOL(recognizer_free_, "vosk_recognizer_free");
-  LOAD_VOSK_SYMBOL(recognizer_accept_, "vosk_recognizer_accept_waveform");
-  LOAD_VOSK_SYMBOL(recognizer_result_, "vosk_recognizer_result");
-  LOAD_VOSK_SYMBOL(recognizer_partial_, "vosk_recognizer_partial_result");
-  LOAD_VOSK_SYMBOL(recognizer_final_, "vosk_recognizer_final_result");
-  LOAD_VOSK_SYMBOL(recognizer_reset_, "vosk_recognizer_reset");
-  LOAD_VOSK_SYMBOL(recognizer_set_words_, "vosk_recognizer_set_words");
-  LOAD_VOSK_SYMBOL(recognizer_set_partial_words_, "vosk_recognizer_set_partial_words");
-  LOAD_VOSK_SYMBOL(set_log_level_, "vosk_set_log_level");
-
-#undef LOAD_VOSK_SYMBOL
-
-  last_error_.clear();
-  return true;
-}
-
-void VoskApi::Unload() {
-  if (handle_ != nullptr) {
-    dlclose(handle_);
-    handle_ = nullptr;
-  }
-  model_new_ = nullptr;
-  model_free_ = nullptr;
-  recognizer_new_ = nullptr;
-  recognizer_free_ = nullptr;
-  recognizer_accept_ = nullptr;
-  recognizer_result_ = nullptr;
-  recognizer_partial_ = nullptr;
-  recognizer_final_ = nullptr;
-  recognizer_reset_ = nullptr;
-  recognizer_set_words_ = nullptr;
-  recognizer_set_partial_words_ = nullptr;
-  set_log_level_ = nullptr;
-}
-
-VoskModel* VoskApi::NewModel(const std::string& path) const {
-  if (!Ready()) {
-    return nullptr;
-  }
-  return model_new_ != nullptr ? model_new_(path.c_str()) : nullptr;
-}
-
-void VoskApi::FreeModel(VoskModel* model) const {
-  if (model != nullptr && model_free_ != nullptr) {
-    model_free_(model);
-  }
-}
-
-VoskRecognizer* VoskApi::NewRecognizer(VoskModel* model, float sample_rate) const {
-  if (!Ready() || model == nullptr || recognizer_new_ == nullptr) {
-    return nullptr;
-  }
-  return recognizer_new_(model, sample_rate);
-}
-
-void VoskApi::FreeRecognizer(VoskRecognizer* recognizer) const {
-  if (recognizer != nullptr && recognizer_free_ != nullptr) {
-    recognizer_free_(recognizer);
-  }
-}
-
-int VoskApi::AcceptWaveform(VoskRecognizer* recognizer, const int16_t* data, int frames) const {
-  if (recognizer == nullptr || recognizer_accept_ == nullptr || data == nullptr || frames <= 0) {
-    return 0;
-  }
-  const int bytes = static_cast<int>(frames * sizeof(int16_t));
-  return recognizer_accept_(recognizer, reinterpret_cast<const char*>(data), bytes);
-}
-
-std::string VoskApi::Result(VoskRecognizer* recognizer) const {
-  if (recognizer == nullptr || recognizer_result_ == nullptr) {
-    return {};
-  }
-  const char* value = recognizer_result_(recognizer);
-  return value != nullptr ? std::string(value) : std::string();
-}
-
-std::string VoskApi::PartialResult(VoskRecognizer* recognizer) const {
-  if (recognizer == nullptr || recognizer_partial_ == nullptr) {
-    return {};
-  }
-  const char* value = recognizer_partial_(recognizer);
-  return value != nullptr ? std::string(value) : std::string();
-}
+namespace speech_to_text_linux {
 
-std::string VoskApi::FinalResult(VoskRecognizer* recognizer) const {
-  if (recognizer == nullptr || recognizer_final_ == nullptr) {
+// Turns a list of phrases into the JSON grammar Vosk expects. `[unk]` lets
+// out-of-grammar speech come back as unknown instead of the closest phrase.
+// Returns an empty string when |phrases| holds no phrase.
+static std::string BuildGrammarJson(FlValue* phrases, bool allow_unknown) {
+  if (phrases == nullptr || fl_value_get_type(phrases) != FL_VALUE_TYPE_LIST) {
     return {};
   }
-  const char* value = recognizer_final_(recognizer);
-  return value != nullptr ? std::string(value) : std::string();
-}
-
-void VoskApi::Reset(VoskRecognizer* recognizer) const {
-  if (recognizer != nullptr && recognizer_reset_ != nullptr) {
-    recognizer_reset_(recognizer);
-  }
-}
-
-void VoskApi::EnableWordTimings(VoskRecognizer* recognizer) const {
-  if (recognizer != nullptr && recognizer_set_words_ != nullptr) {
-    recognizer_set_words_(recognizer, 1);
-  }
-}
-
-void VoskApi::EnablePartialWords(VoskRecognizer* recognizer, bool enabled) const {
-  if (recognizer != nullptr && recognizer_set_partial_words_ != nullptr) {
-    recognizer_set_partial_words_(recognizer, enabled ? 1 : 0);
-  }
-}
-
-void VoskApi::ConfigureLogging(bool debug) const {
-  if (set_log_level_ != nullptr) {
-    set_log_level_(debug ? 0 : -1);
-  }
-}
-
-// Utility helpers -----------------------------------------------------------
-
-static std::string EscapeJson(const std::string& value) {
-  std::ostringstream oss;
-  for (unsigned char ch : value) {
-    switch (ch) {
-      case '\\':
-        oss << "\\\\";
-        break;
-      case '"':
-        oss << "\\\"";
-        break;
-      case '\b':
-        oss << "\\b";
-        break;
-      case '\f':
-        oss << "\\f";
-        break;
-      case '\n':
-        oss << "\\n";
-        break;
-      case '\r':
-        oss << "\\r";
-        break;
-      case '\t':
-        oss << "\\t";
-        break;
-      default:
-        if (ch < 0x20) {
-          oss << "\\u" << std::uppercase << std::hex << std::setw(4) << std::setfill('0')
-              << static_cast<int>(ch) << std::nouppercase << std::dec;
-        } else {
-          oss << ch;
-        }
-        break;
-    }
-  }
-  return oss.str();
-}
-
-static std::string BuildErrorJson(const std::string& message, bool permanent) {
-  std::ostringstream oss;
-  oss << "{\"errorMsg\":\"" << EscapeJson(message) << "\",\"permanent\":"
-      << (permanent ? "true" : "false") << "}";
-  return oss.str();
-}
-
-static std::string BuildRecognitionPayload(const std::string& text, double confidence,
-                                           bool final_result) {
   std::ostringstream oss;
-  oss << std::fixed << std::setprecision(3);
-  double safe_confidence = confidence;
-  if (safe_confidence < 0.0) {
-    safe_confidence = -1.0;
-  } else if (safe_confidence > 1.0) {
-    safe_confidence = 1.0;
-  }
-  oss << "{\"alternates\":[{\"recognizedWords\":\"" << EscapeJson(text)
-      << "\",\"confidence\":" << safe_confidence << "}],\"resultType\":"
-      << (final_result ? kFinalResult : kPartialResult) << "}";
-  return oss.str();
-}
-
-static std::string ExtractJsonText(const std::string& json, const std::string& key) {
-  const std::string needle = "\"" + key + "\"";
-  const std::size_t key_pos = json.find(needle);
-  if (key_pos == std::string::npos) {
-    return {};
-  }
-  std::size_t colon = json.find(':', key_pos);
-  if (colon == std::string::npos) {
-    return {};
-  }
-  colon++;
-  while (colon < json.size() && std::isspace(static_cast<unsigned char>(json[colon]))) {
-    colon++;
-  }
-  if (colon >= json.size() || json[colon] != '"') {
-    return {};
-  }
-  colon++;
-  std::string value;
-  while (colon < json.size()) {
-    const char ch = json[colon];
-    if (ch == '"') {
-      break;
-    }
-    if (ch == '\\' && colon + 1 < json.size()) {
-      const char next = json[colon + 1];
-      switch (next) {
-        case '\\':
-          value.push_back('\\');
-          break;
-        case '"':
-          value.push_back('"');
-          break;
-        case 'n':
-          value.push_back('\n');
-          break;
-        case 't':
-          value.push_back('\t');
-          break;
-        default:
-          value.push_back(next);
-          break;
-      }
-      colon += 2;
-      continue;
-    }
-    value.push_back(ch);
-    colon++;
-  }
-  return value;
-}
-
-static double ExtractAverageConfidence(const std::string& json) {
-  double sum = 0.0;
+  oss << "[";
   int count = 0;
-  std::size_t pos = 0;
-  while (true) {
-    pos = json.find("\"conf\"", pos);
-    if (pos == std::string::npos) {
-      break;
-    }
-    pos = json.find(':', pos);
-    if (pos == std::string::npos) {
-      break;
-    }
-    pos++;
-    while (pos < json.size() && std::isspace(static_cast<unsigned char>(json[pos]))) {
-      pos++;
-    }
-    std::size_t end = pos;
-    while (end < json.size()) {
-      char ch = json[end];
-      if ((ch >= '0' && ch <= '9') || ch == '.' || ch == '-' || ch == '+') {
-        end++;
-      } else {
-        break;
-      }
-    }
-    if (end <= pos) {
-      break;
-    }
-    try {
-      const double value = std::stod(json.substr(pos, end - pos));
-      sum += value;
-      count++;
-    } catch (...) {
-      // ignore parsing failures
+  for (size_t i = 0; i < fl_value_get_length(phrases); ++i) {
+    FlValue* phrase = fl_value_get_list_value(phrases, i);
+    if (fl_value_get_type(phrase) != FL_VALUE_TYPE_STRING) {
+      continue;
     }
-    pos = end;
+    oss << (count++ > 0 ? "," : "") << "\"" << EscapeJson(fl_value_get_string(phrase)) << "\"";
   }
   if (count == 0) {
-    return -1.0;
-  }
-  return sum / static_cast<double>(count);
-}
-
-static double ComputeSoundLevel(const int16_t* buffer, int frames) {
-  if (buffer == nullptr || frames <= 0) {
-    return 0.0;
-  }
-  double accum = 0.0;
-  for (int i = 0; i < frames; ++i) {
-    const double normalized = static_cast<double>(buffer[i]) / 32768.0;
-    accum += normalized * normalized;
-  }
-  const double rms = std::sqrt(accum / frames);
-  double db = 20.0 * std::log10(rms + 1e-9) + 90.0;
-  if (!std::isfinite(db) || db < 0.0) {
-    db = 0.0;
+    return {};
   }
-  if (db > 120.0) {
-    db = 120.0;
+  if (allow_unknown) {
+    oss << ",\"[unk]\"";
   }
-  return db;
-}
-
-static std::string DescribePaError(PaError error_code) {
-  std::ostringstream oss;
-  oss << "PortAudio error (" << error_code << "): " << Pa_GetErrorText(error_code);
+  oss << "]";
   return oss.str();
 }
 
-static std::string ListAvailableInputDevices() {
-  const PaError count = Pa_GetDeviceCount();
-  if (count < 0) {
-    return DescribePaError(count);
-  }
-  if (count == 0) {
-    return "No input devices detected.";
-  }
-  std::ostringstream oss;
-  for (int i = 0; i < count; ++i) {
-    const PaDeviceInfo* info = Pa_GetDeviceInfo(i);
-    if (info == nullptr || info->maxInputChannels <= 0) {
-      continue;
-    }
-    const PaHostApiInfo* api_info = Pa_GetHostApiInfo(info->hostApi);
-    oss << "[" << i << "] " << (info->name != nullptr ? info->name : "unknown")
-        << " (API: " << (api_info != nullptr && api_info->name != nullptr ? api_info->name : "unknown")
-        << ", channels: " << info->maxInputChannels
-        << ", default SR: " << info->defaultSampleRate << ")\n";
-  }
-  std::string result = oss.str();
-  if (result.empty()) {
-    return "No input-capable devices detected.";
-  }
-  return result;
-}
-
-static StreamOpenResult OpenInputStreamWithTimeout(
-    const PaStreamParameters& params, int sample_rate,
-    unsigned long frames_per_buffer, std::chrono::milliseconds timeout) {
-  auto promise =
-      std::make_shared<std::promise<StreamOpenResult>>();
-  std::future<StreamOpenResult> future = promise->get_future();
-  auto cancelled = std::make_shared<std::atomic<bool>>(false);
-  std::thread([promise, cancelled, params, sample_rate,
-               frames_per_buffer]() {
-    PaStream* stream = nullptr;
-    PaError err =
-        Pa_OpenStream(&stream, &params, nullptr, sample_rate,
-                      frames_per_buffer, paClipOff, nullptr, nullptr);
-    if (cancelled->load()) {
-      if (stream != nullptr) {
-        Pa_CloseStream(stream);
-        stream = nullptr;
-      }
-    }
-    promise->set_value(StreamOpenResult{err, stream});
-  }).detach();
-  if (future.wait_for(timeout) == std::future_status::timeout) {
-    cancelled->store(true);
-    return StreamOpenResult{paTimedOut, nullptr, true};
-  }
-  auto result = future.get();
-  result.timed_out = false;
-  return result;
-}
-
 static std::string GuessLocaleFromModelPath(const std::string& path) {
   auto separator = path.find_last_of("/\\");
   std::string folder = separator == std::string::npos ? path : path.substr(separator + 1);
@@ -603,106 +96,45 @@ static std::string GuessLocaleFromModelPath(const std::string& path) {
   return "en-US";
 }
 
-}  // namespace
-
-struct _SpeechToTextLinuxPlugin {
-  GObject parent_instance;
-  SpeechToTextLinuxPluginState* state;
-  FlMethodChannel* channel;
-  GMainContext* main_context;
-};
-
-G_DEFINE_TYPE(SpeechToTextLinuxPlugin, speech_to_text_linux_plugin, g_object_get_type())
-
-static void DebugLog(SpeechToTextLinuxPlugin* self, const std::string& message) {
-  if (self == nullptr || self->state == nullptr || !self->state->debug_logging) {
-    return;
-  }
-  g_message("speech_to_text_linux: %s", message.c_str());
-}
-
-struct PendingStringInvoke {
-  SpeechToTextLinuxPlugin* plugin;
-  gchar* method;
-  gchar* payload;
-};
-
-struct PendingDoubleInvoke {
-  SpeechToTextLinuxPlugin* plugin;
-  gchar* method;
-  double value;
-};
-
-static void InvokeStringOnMain(SpeechToTextLinuxPlugin* self, const char* method,
-                               const std::string& payload) {
-  if (self == nullptr || self->channel == nullptr || self->main_context == nullptr) {
-    return;
-  }
-  auto* data = new PendingStringInvoke{
-      SPEECH_TO_TEXT_LINUX_PLUGIN(g_object_ref(self)),
-      g_strdup(method),
-      g_strdup(payload.c_str()),
-  };
-  g_main_context_invoke_full(
-      self->main_context, G_PRIORITY_DEFAULT,
-      [](gpointer user_data) -> gboolean {
-        auto* data = static_cast<PendingStringInvoke*>(user_data);
-        if (data->plugin->channel != nullptr) {
-          g_autoptr(FlValue) value = fl_value_new_string(data->payload);
-          fl_method_channel_invoke_method(data->plugin->channel, data->method, value,
-                                          nullptr, nullptr, nullptr);
-        }
-        g_free(data->method);
-        g_free(data->payload);
-        g_object_unref(data->plugin);
-        delete data;
-        return G_SOURCE_REMOVE;
-      },
-      data, nullptr);
-}
-
-static void InvokeDoubleOnMain(SpeechToTextLinuxPlugin* self, const char* method,
-                               double value) {
-  if (self == nullptr || self->channel == nullptr || self->main_context == nullptr) {
+// Charges the platform thread's CPU time since |cpu_started| to the plugin.
+static void RecordMainThreadCpu(PluginCore* self, double cpu_started) {
+  if (self->state == nullptr) {
     return;
   }
-  auto* data = new PendingDoubleInvoke{
-      SPEECH_TO_TEXT_LINUX_PLUGIN(g_object_ref(self)), g_strdup(method), value};
-  g_main_context_invoke_full(
-      self->main_context, G_PRIORITY_DEFAULT,
-      [](gpointer user_data) -> gboolean {
-        auto* data = static_cast<PendingDoubleInvoke*>(user_data);
-        if (data->plugin->channel != nullptr) {
-          g_autoptr(FlValue) value = fl_value_new_float(data->value);
-          fl_method_channel_invoke_method(data->plugin->channel, data->method, value,
-                                          nullptr, nullptr, nullptr);
-        }
-        g_free(data->method);
-        g_object_unref(data->plugin);
-        delete data;
-        return G_SOURCE_REMOVE;
-      },
-      data, nullptr);
+  const double spent = ThreadCpuSeconds() - cpu_started;
+  std::lock_guard<std::mutex> lock(self->state->stats.mutex);
+  self->state->stats.main_thread_cpu_seconds += spent;
 }
 
-static void SendStatus(SpeechToTextLinuxPlugin* self, const std::string& status) {
-  InvokeStringOnMain(self, "notifyStatus", status);
-}
-
-static void SendError(SpeechToTextLinuxPlugin* self, const std::string& message,
-                      bool permanent) {
-  InvokeStringOnMain(self, "notifyError", BuildErrorJson(message, permanent));
+// Sends every queued event. Disarms the source first, so an event posted
+// while draining re-arms it.
+static gboolean DispatchEvents(gpointer user_data) {
+  PluginCore* self = static_cast<PluginCore*>(user_data);
+  const double cpu_started = ThreadCpuSeconds();
+  g_source_set_ready_time(self->event_source, -1);
+  EventQueue::Event* event = nullptr;
+  while ((event = self->events->Pop()) != nullptr) {
+    g_autoptr(FlValue) typed = event->typed;
+    event->typed = nullptr;
+    if (self->channel == nullptr) {
+      continue;
+    }
+    g_autoptr(FlValue) value = typed != nullptr      ? fl_value_ref(typed)
+                               : event->is_double ? fl_value_new_float(event->value)
+                                                  : fl_value_new_string(event->payload.c_str());
+    fl_method_channel_invoke_method(self->channel, event->method, value, nullptr, nullptr,
+                                    nullptr);
+  }
+  RecordMainThreadCpu(self, cpu_started);
+  return G_SOURCE_CONTINUE;
 }
 
-static void SendRecognition(SpeechToTextLinuxPlugin* self, const std::string& text,
-                            double confidence, bool final_result) {
-  InvokeStringOnMain(self, "textRecognition",
-                     BuildRecognitionPayload(text, confidence, final_result));
+static gboolean DispatchEventSource(GSource* source, GSourceFunc callback, gpointer user_data) {
+  return callback != nullptr ? callback(user_data) : G_SOURCE_CONTINUE;
 }
 
-static void SendSoundLevel(SpeechToTextLinuxPlugin* self, double level) {
-  InvokeDoubleOnMain(self, "soundLevelChange", level);
-}
+static GSourceFuncs event_source_funcs = {nullptr, nullptr, DispatchEventSource, nullptr,
+                                          nullptr, nullptr};
 
 static FlValue* LookupValue(FlValue* map, const char* key) {
   if (map == nullptr || fl_value_get_type(map) != FL_VALUE_TYPE_MAP) {
@@ -748,117 +180,121 @@ static gint64 GetIntArg(FlValue* map, const char* key, gint64 fallback) {
   }
 }
 
-static void CloseStreamLocked(SpeechToTextLinuxPluginState* state) {
-  if (state->stream != nullptr) {
-    Pa_CloseStream(state->stream);
-    state->stream = nullptr;
+static double GetDoubleArg(FlValue* map, const char* key, double fallback) {
+  FlValue* value = LookupValue(map, key);
+  if (value == nullptr) {
+    return fallback;
   }
-}
-
-static void ReleaseRecognizerLocked(SpeechToTextLinuxPluginState* state) {
-  if (state->recognizer != nullptr) {
-    state->vosk.FreeRecognizer(state->recognizer);
-    state->recognizer = nullptr;
+  switch (fl_value_get_type(value)) {
+    case FL_VALUE_TYPE_INT:
+      return static_cast<double>(fl_value_get_int(value));
+    case FL_VALUE_TYPE_FLOAT:
+      return fl_value_get_float(value);
+    default:
+      return fallback;
   }
 }
 
-static void CaptureLoop(SpeechToTextLinuxPlugin* self) {
-  SpeechToTextLinuxPluginState* state = self->state;
-  if (state == nullptr) {
-    return;
+// The Linux listen options `initialize` may set as defaults for every
+// `listen`; the rest of the initialize arguments are not listen options.
+constexpr const char* kListenOptionKeys[] = {
+    "adaptiveDecoding", "adaptiveHoldMillis", "adaptiveRtfHigh", "adaptiveRtfLow", "audioSpans",
+    "continuous", "dropSilenceWhenBehind", "endpointSilenceMillis", "endpointThresholdDb",
+    "grammar", "grammarUnknown", "inputDeviceIndex", "inputDeviceName", "keywordPreRollMillis",
+    "keywords", "lightModelPath", "maxAlternatives", "overlappedStart", "pickLanguage",
+    "pickLanguageMargin", "pickLanguageMinWords", "recognizerName", "recognizers",
+    "recordDirectory", "recordMaxBytes", "recordMaxSeconds", "secondPassBudgetMillis",
+    "secondPassMaxQueue", "secondPassModelPath", "transcriptJournalFsync",
+    "transcriptJournalFsyncMillis", "transcriptJournalPath", "voskEndpointerEndMillis",
+    "voskEndpointerMaxMillis", "voskEndpointerMode", "voskEndpointerStartMaxMillis", "wordTimings"};
+
+// Deep copy, for values that cross threads: FlValue reference counts are
+// not atomic, so the control worker, handles and listen defaults never
+// share a value with the call it came from.
+static FlValue* CopyValue(FlValue* value) {
+  if (value == nullptr) {
+    return fl_value_new_null();
   }
-  const int frames = static_cast<int>(state->frames_per_buffer);
-  std::vector<int16_t> buffer(frames);
-  state->ResetRecognitionTimers();
-
-  while (!state->stop_requested.load()) {
-    const PaError err = Pa_ReadStream(state->stream, buffer.data(), frames);
-    if (err == paInputOverflowed) {
-      continue;
-    }
-    if (err == paStreamIsStopped || err == paStreamIsNotStopped) {
-      break;
-    }
-    if (err != paNoError) {
-      SendError(self, DescribePaError(err), true);
-      break;
-    }
-    SendSoundLevel(self, ComputeSoundLevel(buffer.data(), frames));
-    const int accepted =
-        state->vosk.AcceptWaveform(state->recognizer, buffer.data(), frames);
-    if (accepted != 0) {
-      const std::string json = state->vosk.Result(state->recognizer);
-      const std::string text = ExtractJsonText(json, "text");
-      if (!text.empty()) {
-        state->reported_speech = true;
-        state->last_speech_at = std::chrono::steady_clock::now();
-        const double confidence = ExtractAverageConfidence(json);
-        SendRecognition(self, text, confidence, true);
-      }
-    } else if (state->partial_results_enabled) {
-      const std::string json = state->vosk.PartialResult(state->recognizer);
-      const std::string text = ExtractJsonText(json, "partial");
-      if (!text.empty() && text != state->last_partial_text) {
-        state->reported_speech = true;
-        state->last_partial_text = text;
-        state->last_speech_at = std::chrono::steady_clock::now();
-        SendRecognition(self, text, -1.0, false);
+  switch (fl_value_get_type(value)) {
+    case FL_VALUE_TYPE_BOOL:
+      return fl_value_new_bool(fl_value_get_bool(value));
+    case FL_VALUE_TYPE_INT:
+      return fl_value_new_int(fl_value_get_int(value));
+    case FL_VALUE_TYPE_FLOAT:
+      return fl_value_new_float(fl_value_get_float(value));
+    case FL_VALUE_TYPE_STRING:
+      return fl_value_new_string(fl_value_get_string(value));
+    case FL_VALUE_TYPE_UINT8_LIST:
+      return fl_value_new_uint8_list(fl_value_get_uint8_list(value),
+                                     fl_value_get_length(value));
+    case FL_VALUE_TYPE_INT32_LIST:
+      return fl_value_new_int32_list(fl_value_get_int32_list(value),
+                                     fl_value_get_length(value));
+    case FL_VALUE_TYPE_INT64_LIST:
+      return fl_value_new_int64_list(fl_value_get_int64_list(value),
+                                     fl_value_get_length(value));
+    case FL_VALUE_TYPE_FLOAT_LIST:
+      return fl_value_new_float_list(fl_value_get_float_list(value),
+                                     fl_value_get_length(value));
+    case FL_VALUE_TYPE_LIST: {
+      FlValue* list = fl_value_new_list();
+      for (size_t i = 0; i < fl_value_get_length(value); ++i) {
+        fl_value_append_take(list, CopyValue(fl_value_get_list_value(value, i)));
       }
+      return list;
     }
-
-    const auto now = std::chrono::steady_clock::now();
-    if (state->listen_timeout.count() > 0 &&
-        now - state->listen_started >= state->listen_timeout) {
-      break;
-    }
-    if (state->pause_timeout.count() > 0 && state->reported_speech &&
-        now - state->last_speech_at >= state->pause_timeout) {
-      break;
+    case FL_VALUE_TYPE_MAP: {
+      FlValue* map = fl_value_new_map();
+      for (size_t i = 0; i < fl_value_get_length(value); ++i) {
+        fl_value_set_take(map, CopyValue(fl_value_get_map_key(value, i)),
+                          CopyValue(fl_value_get_map_value(value, i)));
+      }
+      return map;
     }
+    default:
+      return fl_value_new_null();
   }
+}
 
-  if (!state->cancel_requested.load()) {
-    const std::string final_json = state->vosk.FinalResult(state->recognizer);
-    const std::string text = ExtractJsonText(final_json, "text");
-    if (!text.empty()) {
-      const double confidence = ExtractAverageConfidence(final_json);
-      SendRecognition(self, text, confidence, true);
-      state->reported_speech = true;
-    }
+// Returns a new map with copies of the listen options found in the
+// `initialize` arguments |args|, or null when there are none.
+static FlValue* CopyListenDefaults(FlValue* args) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return nullptr;
   }
-
-  SendStatus(self, "notListening");
-  if (!state->cancel_requested.load()) {
-    if (state->reported_speech) {
-      SendStatus(self, "done");
-    } else {
-      SendStatus(self, "doneNoResult");
+  FlValue* defaults = nullptr;
+  for (const char* key : kListenOptionKeys) {
+    FlValue* value = fl_value_lookup_string(args, key);
+    if (value == nullptr || fl_value_get_type(value) == FL_VALUE_TYPE_NULL) {
+      continue;
     }
+    if (defaults == nullptr) {
+      defaults = fl_value_new_map();
+    }
+    fl_value_set_string_take(defaults, key, CopyValue(value));
   }
-
-  {
-    std::lock_guard<std::mutex> lock(state->mutex);
-    CloseStreamLocked(state);
-    ReleaseRecognizerLocked(state);
-    state->listening = false;
-  }
+  return defaults;
 }
 
-static void StopCaptureThread(SpeechToTextLinuxPluginState* state) {
-  if (state == nullptr) {
-    return;
-  }
-  if (state->stream != nullptr) {
-    Pa_StopStream(state->stream);
-    Pa_AbortStream(state->stream);
-  }
-  state->stop_requested.store(true);
-  if (state->capture_thread_running) {
-    if (state->capture_thread.joinable()) {
-      state->capture_thread.join();
+// Returns a new map holding copies of |defaults| overlaid with the non-null
+// entries of |args|, so initialize-time Linux options act as per-listen
+// defaults. Nothing is shared with the sources, which other threads free.
+static FlValue* MergeListenArgs(FlValue* defaults, FlValue* args) {
+  FlValue* merged = fl_value_new_map();
+  for (FlValue* source : {defaults, args}) {
+    if (source == nullptr || fl_value_get_type(source) != FL_VALUE_TYPE_MAP) {
+      continue;
+    }
+    const size_t length = fl_value_get_length(source);
+    for (size_t i = 0; i < length; ++i) {
+      FlValue* value = fl_value_get_map_value(source, i);
+      if (fl_value_get_type(value) == FL_VALUE_TYPE_NULL) {
+        continue;
+      }
+      fl_value_set_take(merged, CopyValue(fl_value_get_map_key(source, i)), CopyValue(value));
     }
-    state->capture_thread_running = false;
   }
+  return merged;
 }
 
 static FlMethodResponse* SuccessBool(bool value) {
@@ -879,7 +315,41 @@ static FlMethodResponse* HandleHasPermission() {
   return SuccessBool(true);
 }
 
-static FlMethodResponse* HandleInitialize(SpeechToTextLinuxPlugin* self, FlValue* args) {
+// Returns the already loaded model a recognizer lane asked for, or null.
+// An empty path or the main model's path shares the main model.
+static VoskModel* LaneModelLocked(SpeechToTextLinuxPluginState* state,
+                                  const std::string& path) {
+  if (path.empty() || path == state->model_path) {
+    return state->model;
+  }
+  auto found = state->lane_models.find(path);
+  return found != state->lane_models.end() ? found->second : nullptr;
+}
+
+// Like LaneModelLocked, but loads a model not seen before, with `lock`
+// released so stop and stats calls are not held up for the seconds a large
+// model takes to load. Callers re-validate anything the lock protected.
+static VoskModel* PreloadLaneModel(SpeechToTextLinuxPluginState* state,
+                                   std::unique_lock<std::mutex>* lock,
+                                   const std::string& path) {
+  VoskModel* loaded = LaneModelLocked(state, path);
+  if (loaded != nullptr || path.empty() || path == state->model_path) {
+    return loaded;
+  }
+  lock->unlock();
+  VoskModel* model = state->vosk.NewModel(path);
+  lock->lock();
+  if (model == nullptr) {
+    return nullptr;
+  }
+  auto inserted = state->lane_models.insert(std::make_pair(path, model));
+  if (!inserted.second) {
+    state->vosk.FreeModel(model);
+  }
+  return inserted.first->second;
+}
+
+static FlMethodResponse* HandleInitialize(PluginCore* self, FlValue* args) {
   SpeechToTextLinuxPluginState* state = self->state;
   if (state == nullptr) {
     return MakeError("state_unavailable", "Plugin state not initialized");
@@ -905,28 +375,22 @@ static FlMethodResponse* HandleInitialize(SpeechToTextLinuxPlugin* self, FlValue
   }
   state->vosk.ConfigureLogging(debug);
 
+  // The library stays loaded until dispose, so the model can be read
+  // without holding the lock.
+  lock.unlock();
   VoskModel* new_model = state->vosk.NewModel(model_path);
+  lock.lock();
   if (new_model == nullptr) {
     SendError(self, "Failed to open Vosk model", true);
     return SuccessBool(false);
   }
   if (state->model != nullptr) {
+    state->ClearRecognizerPoolLocked();
     state->vosk.FreeModel(state->model);
   }
   state->model = new_model;
   state->model_path = model_path;
 
-  if (!state->pa_initialized) {
-    const PaError err = Pa_Initialize();
-    if (err != paNoError) {
-      state->vosk.FreeModel(state->model);
-      state->model = nullptr;
-      SendError(self, DescribePaError(err), true);
-      return SuccessBool(false);
-    }
-    state->pa_initialized = true;
-  }
-
   std::string locale = GetStringArg(args, "modelLocale");
   if (locale.empty()) {
     locale = GuessLocaleFromModelPath(model_path);
@@ -937,54 +401,358 @@ static FlMethodResponse* HandleInitialize(SpeechToTextLinuxPlugin* self, FlValue
   }
   state->locale_tag = locale;
   state->locale_label = locale + ":" + display_name;
+  if (state->listen_defaults != nullptr) {
+    fl_value_unref(state->listen_defaults);
+  }
+  state->listen_defaults = CopyListenDefaults(args);
+  state->decode_threads = static_cast<int>(GetIntArg(args, "decodeThreads", 0));
+  // Load lane, second-pass and light models now rather than on the first
+  // `listen`, and retire the ones an earlier `initialize` loaded that are
+  // no longer wanted.
+  std::vector<std::string> lane_paths;
+  for (const char* key : {"secondPassModelPath", "lightModelPath"}) {
+    const std::string path = GetStringArg(args, key);
+    if (!path.empty()) {
+      lane_paths.push_back(path);
+    }
+  }
+  FlValue* lanes = LookupValue(args, "recognizers");
+  if (lanes != nullptr && fl_value_get_type(lanes) == FL_VALUE_TYPE_LIST) {
+    for (size_t i = 0; i < fl_value_get_length(lanes); ++i) {
+      lane_paths.push_back(GetStringArg(fl_value_get_list_value(lanes, i), "modelPath"));
+    }
+  }
+  auto stale = state->lane_models.begin();
+  while (stale != state->lane_models.end()) {
+    if (std::find(lane_paths.begin(), lane_paths.end(), stale->first) == lane_paths.end()) {
+      state->retired_models.push_back(stale->second);
+      stale = state->lane_models.erase(stale);
+    } else {
+      ++stale;
+    }
+  }
+  state->ReapFinishedSessionsLocked();
+  for (const std::string& path : lane_paths) {
+    if (PreloadLaneModel(state, &lock, path) == nullptr) {
+      SendError(self, "Failed to open Vosk model " + path, false);
+    }
+  }
   state->initialized = true;
 
   DebugLog(self, "Vosk model loaded from " + model_path);
   return SuccessBool(true);
 }
 
-static FlMethodResponse* HandleListen(SpeechToTextLinuxPlugin* self, FlValue* args) {
+static FlMethodResponse* HandleListen(PluginCore* self, FlValue* args) {
   SpeechToTextLinuxPluginState* state = self->state;
   if (state == nullptr) {
     return MakeError("state_unavailable", "Plugin state not initialized");
   }
+  const auto tapped_at = std::chrono::steady_clock::now();
+  // Usually done long before: it started at registration.
+  const PaError port_audio_error = state->WaitForPortAudio();
+  if (port_audio_error != paNoError) {
+    SendError(self, DescribePaError(port_audio_error), true);
+    return SuccessBool(false);
+  }
   std::unique_lock<std::mutex> lock(state->mutex);
   if (!state->initialized || state->model == nullptr) {
     SendError(self, "Speech engine not initialized", true);
     return SuccessBool(false);
   }
-  if (state->listening) {
+  // `sessionId` selects a `createSession` handle; without it `listen` drives
+  // the implicit session behind the legacy callbacks.
+  const int64_t handle_id = GetIntArg(args, "sessionId", 0);
+  SessionHandle* handle = nullptr;
+  if (handle_id != 0) {
+    auto found = state->handles.find(handle_id);
+    if (found == state->handles.end()) {
+      return MakeError("unknown_session", "No session with that id");
+    }
+    handle = found->second.get();
+  }
+  std::shared_ptr<RecognitionSession> previous =
+      handle != nullptr ? handle->active : state->current_session;
+  const SessionPhase previous_phase =
+      previous != nullptr ? previous->phase.load() : SessionPhase::kIdle;
+  if (previous_phase == SessionPhase::kListening || previous_phase == SessionPhase::kStarting) {
     DebugLog(self, "Already listening");
     return SuccessBool(false);
   }
-
-  state->partial_results_enabled =
-      GetBoolArg(args, "partialResults", true);
-  state->sample_rate = static_cast<int>(GetIntArg(args, "sampleRate", state->sample_rate));
-  if (state->sample_rate <= 0) {
-    state->sample_rate = 16000;
+  if (previous_phase == SessionPhase::kStopping) {
+    // The previous session was stopped and finalizes in the background; it
+    // only has to give up the device, which its decode task does within
+    // milliseconds of the stop.
+    lock.unlock();
+    previous->stream_closed_future.wait_for(std::chrono::milliseconds(200));
+    lock.lock();
+  }
+  state->ReapFinishedSessionsLocked();
+  if (handle_id != 0) {
+    // The handle may have been destroyed while we waited for the previous
+    // capture to let go.
+    auto found = state->handles.find(handle_id);
+    if (found == state->handles.end()) {
+      return MakeError("unknown_session", "No session with that id");
+    }
+    handle = found->second.get();
+  }
+
+  // Every capture gets a fresh id, so overlapping captures of one handle
+  // stay apart; payloads name the handle as `handleId`.
+  auto session = std::make_shared<RecognitionSession>(state->next_session_id++, &state->vosk,
+                                                      state->device_mutex);
+  session->handle_id = handle_id;
+  session->phase.store(SessionPhase::kStarting);
+  g_autoptr(FlValue) handle_defaults =
+      MergeListenArgs(state->listen_defaults, handle != nullptr ? handle->options : nullptr);
+  g_autoptr(FlValue) options = MergeListenArgs(handle_defaults, args);
+  session->partial_results_enabled = GetBoolArg(options, "partialResults", true);
+  session->word_timings = GetBoolArg(options, "wordTimings", false);
+  session->audio_spans = GetBoolArg(options, "audioSpans", false);
+  session->sample_rate = static_cast<int>(GetIntArg(options, "sampleRate", 16000));
+  if (session->sample_rate <= 0) {
+    session->sample_rate = 16000;
+  }
+  session->listen_timeout =
+      std::chrono::milliseconds(GetIntArg(options, "listenForMillis", 0));
+  session->pause_timeout =
+      std::chrono::milliseconds(GetIntArg(options, "pauseForMillis", 0));
+  // Opt-in: the speech_to_text facade treats every final as the end of the
+  // session, whatever the listen mode.
+  session->continuous = GetBoolArg(options, "continuous", false);
+  if (session->continuous) {
+    // Pauses only close segments; `listenFor` still bounds the session.
+    session->pause_timeout = std::chrono::milliseconds(0);
+  }
+  // Keyword standby, e.g. `keywords: ['hey kiosk']`: only a grammar
+  // recognizer over voiced audio runs until one of them is heard.
+  FlValue* keywords = LookupValue(options, "keywords");
+  const std::string keyword_grammar = BuildGrammarJson(keywords, true);
+  if (!keyword_grammar.empty()) {
+    if (!state->vosk.SupportsGrammar()) {
+      SendListenError(self, handle_id, "libvosk lacks vosk_recognizer_new_grm");
+      return SuccessBool(false);
+    }
+    std::unique_ptr<KeywordStandby> standby(new KeywordStandby());
+    standby->grammar = keyword_grammar;
+    for (size_t i = 0; i < fl_value_get_length(keywords); ++i) {
+      FlValue* keyword = fl_value_get_list_value(keywords, i);
+      if (fl_value_get_type(keyword) == FL_VALUE_TYPE_STRING) {
+        standby->keywords.push_back(fl_value_get_string(keyword));
+      }
+    }
+    // At least enough for the onset replayed to the spotter.
+    const int64_t pre_roll_ms =
+        std::max<gint64>(GetIntArg(options, "keywordPreRollMillis", 1500), 500);
+    standby->pre_roll.resize(static_cast<size_t>(session->sample_rate * pre_roll_ms / 1000));
+    standby->listen_timeout = session->listen_timeout;
+    session->listen_timeout = std::chrono::milliseconds(0);
+    session->standby = std::move(standby);
+  }
+
+  const std::chrono::milliseconds endpoint_silence(
+      GetIntArg(options, "endpointSilenceMillis", 0));
+  session->endpoint_enabled = endpoint_silence.count() > 0;
+  session->endpointer.Configure(session->sample_rate, endpoint_silence,
+                                GetDoubleArg(options, "endpointThresholdDb", 12.0));
+
+  RecognizerOptions recognizer_options;
+  recognizer_options.sample_rate = static_cast<float>(session->sample_rate);
+  recognizer_options.partial_words = session->partial_results_enabled;
+  recognizer_options.vosk_endpointer_mode =
+      static_cast<int>(GetIntArg(options, "voskEndpointerMode", -1));
+  recognizer_options.vosk_endpointer_end_ms =
+      static_cast<int>(GetIntArg(options, "voskEndpointerEndMillis", 0));
+  recognizer_options.vosk_endpointer_start_max_ms =
+      static_cast<int>(GetIntArg(options, "voskEndpointerStartMaxMillis", 5000));
+  recognizer_options.vosk_endpointer_max_ms =
+      static_cast<int>(GetIntArg(options, "voskEndpointerMaxMillis", 20000));
+  const bool allow_unknown = GetBoolArg(options, "grammarUnknown", true);
+  recognizer_options.grammar = BuildGrammarJson(LookupValue(options, "grammar"), allow_unknown);
+  if (!recognizer_options.grammar.empty() && !state->vosk.SupportsGrammar()) {
+    SendListenError(self, handle_id, "libvosk lacks vosk_recognizer_new_grm");
+    return SuccessBool(false);
+  }
+  // N-best finals, e.g. `maxAlternatives: 5`. The race and the second pass
+  // score a final by its word confidences, which N-best results lack.
+  recognizer_options.max_alternatives =
+      static_cast<int>(std::max<gint64>(GetIntArg(options, "maxAlternatives", 0), 0));
+  if (recognizer_options.max_alternatives > 0) {
+    if (!state->vosk.SupportsAlternatives()) {
+      SendListenError(self, handle_id, "libvosk lacks vosk_recognizer_set_max_alternatives");
+      return SuccessBool(false);
+    }
+    if (GetBoolArg(options, "pickLanguage", false) ||
+        !GetStringArg(options, "secondPassModelPath").empty()) {
+      SendListenError(self, handle_id,
+                      "maxAlternatives cannot be combined with pickLanguage or a second pass");
+      return SuccessBool(false);
+    }
+  }
+  session->max_alternatives = recognizer_options.max_alternatives;
+  session->wants_vosk_endpointer = recognizer_options.wants_vosk_endpointer();
+  // Endpointer, grammar and N-best settings stick to a recognizer, so only
+  // plain ones are pooled.
+  session->poolable = !session->wants_vosk_endpointer && recognizer_options.grammar.empty() &&
+                      recognizer_options.max_alternatives == 0;
+  session->model = state->model;
+
+  // Extra recognizers fed from the same capture, e.g.
+  // `recognizers: [{name: 'commands', modelPath: ...}]`.
+  const std::string primary_name = GetStringArg(options, "recognizerName");
+  if (!primary_name.empty()) {
+    session->recognizer_name = primary_name;
+  }
+  // Models `initialize` did not preload are read with the plugin lock
+  // released; `handle` is looked up again before it is next used.
+  FlValue* lanes = LookupValue(options, "recognizers");
+  if (lanes != nullptr && fl_value_get_type(lanes) == FL_VALUE_TYPE_LIST) {
+    for (size_t i = 0; i < fl_value_get_length(lanes); ++i) {
+      FlValue* entry = fl_value_get_list_value(lanes, i);
+      std::unique_ptr<RecognizerLane> lane(new RecognizerLane());
+      lane->session = session.get();
+      lane->name = GetStringArg(entry, "name");
+      if (lane->name.empty()) {
+        lane->name = "recognizer" + std::to_string(i + 1);
+      }
+      lane->model = PreloadLaneModel(state, &lock, GetStringArg(entry, "modelPath"));
+      if (lane->model == nullptr) {
+        SendListenError(self, handle_id, "Failed to open Vosk model for " + lane->name);
+        return SuccessBool(false);
+      }
+      lane->options.sample_rate = recognizer_options.sample_rate;
+      lane->options.partial_words =
+          GetBoolArg(entry, "partialResults", session->partial_results_enabled);
+      lane->options.grammar = BuildGrammarJson(LookupValue(entry, "grammar"), allow_unknown);
+      if (!lane->options.grammar.empty() && !state->vosk.SupportsGrammar()) {
+        SendListenError(self, handle_id, "libvosk lacks vosk_recognizer_new_grm");
+        return SuccessBool(false);
+      }
+      session->lanes.push_back(std::move(lane));
+    }
+  }
+  session->open_recognizers.store(static_cast<int>(session->lanes.size()) + 1);
+  const std::string second_pass_path = GetStringArg(options, "secondPassModelPath");
+  if (!second_pass_path.empty() && !GetBoolArg(options, "pickLanguage", false)) {
+    std::unique_ptr<SecondPass> pass(new SecondPass());
+    pass->model = PreloadLaneModel(state, &lock, second_pass_path);
+    if (pass->model == nullptr) {
+      SendListenError(self, handle_id, "Failed to open Vosk model " + second_pass_path);
+      return SuccessBool(false);
+    }
+    pass->max_queue =
+        static_cast<size_t>(std::max<gint64>(GetIntArg(options, "secondPassMaxQueue", 2), 1));
+    pass->budget =
+        std::chrono::milliseconds(GetIntArg(options, "secondPassBudgetMillis", 1500));
+    session->second_pass = std::move(pass);
+  }
+  // Adaptive decoding under CPU pressure; `lightModelPath` enables it and
+  // adds the model switch as the last step.
+  const std::string light_path = GetStringArg(options, "lightModelPath");
+  if (GetBoolArg(options, "adaptiveDecoding", !light_path.empty())) {
+    std::unique_ptr<AdaptiveDecoding> adaptive(new AdaptiveDecoding());
+    if (!light_path.empty()) {
+      adaptive->light_model = PreloadLaneModel(state, &lock, light_path);
+      if (adaptive->light_model == nullptr) {
+        SendListenError(self, handle_id, "Failed to open Vosk model " + light_path);
+        return SuccessBool(false);
+      }
+    }
+    adaptive->options = recognizer_options;
+    adaptive->rtf_high = GetDoubleArg(options, "adaptiveRtfHigh", 0.8);
+    adaptive->rtf_low = GetDoubleArg(options, "adaptiveRtfLow", 0.5);
+    adaptive->hold = std::chrono::milliseconds(GetIntArg(options, "adaptiveHoldMillis", 2000));
+    session->adaptive = std::move(adaptive);
+  }
+  if (!session->lanes.empty() && GetBoolArg(options, "pickLanguage", false)) {
+    session->race.reset(new LanguageRace());
+    session->race->margin = GetDoubleArg(options, "pickLanguageMargin", 0.15);
+    session->race->min_words = GetIntArg(options, "pickLanguageMinWords", 3);
+    RaceCandidate own;
+    own.name = session->recognizer_name;
+    session->race->candidates.push_back(own);
+    for (size_t i = 0; i < session->lanes.size(); ++i) {
+      RaceCandidate candidate;
+      candidate.name = session->lanes[i]->name;
+      session->race->candidates.push_back(candidate);
+      session->lanes[i]->race_index = static_cast<int>(i) + 1;
+    }
   }
-  state->listen_timeout =
-      std::chrono::milliseconds(GetIntArg(args, "listenForMillis", 0));
-  state->pause_timeout =
-      std::chrono::milliseconds(GetIntArg(args, "pauseForMillis", 0));
 
-  ReleaseRecognizerLocked(state);
-  state->recognizer = state->vosk.NewRecognizer(state->model, state->sample_rate);
-  if (state->recognizer == nullptr) {
-    SendError(self, "Failed to create Vosk recognizer", true);
-    return SuccessBool(false);
+  // Building the recognizer and opening the device both take a while; by
+  // default they run concurrently and the first decode task picks up the
+  // recognizer once it is ready. `overlappedStart: false` keeps the old
+  // sequential order for comparison. A pooled recognizer skips the build.
+  session->tapped_at = tapped_at;
+  session->start_mode = GetBoolArg(options, "overlappedStart", true) ? StartMode::kOverlapped
+                                                                     : StartMode::kSequential;
+  const PooledRecognizer pooled = session->poolable
+                                      ? TakePooledRecognizerLocked(state, session->sample_rate)
+                                      : PooledRecognizer{nullptr, session->sample_rate, 0};
+  if (pooled.recognizer != nullptr) {
+    state->vosk.EnablePartialWords(pooled.recognizer, session->partial_results_enabled);
+    std::promise<RecognizerSetup> ready;
+    ready.set_value(RecognizerSetup{pooled.recognizer, false, pooled.fed_samples});
+    session->pending_recognizer = ready.get_future();
+    std::lock_guard<std::mutex> stats_lock(state->stats.mutex);
+    state->stats.pooled_recognizers++;
+  } else {
+    const VoskApi* vosk = &state->vosk;
+    VoskModel* model = state->model;
+    RecognitionSession* waiting = session.get();
+    session->pending_recognizer = std::async(
+        session->start_mode == StartMode::kOverlapped ? std::launch::async : std::launch::deferred,
+        [vosk, model, recognizer_options, waiting] {
+          const RecognizerSetup setup = CreateRecognizer(vosk, model, recognizer_options);
+          // The session's decode task may be waiting for the recognizer.
+          waiting->waker.Notify();
+          return setup;
+        });
+    if (session->start_mode == StartMode::kSequential) {
+      // Not registered yet, and other blocking calls wait for this one.
+      lock.unlock();
+      session->pending_recognizer.wait();
+      lock.lock();
+    }
+  }
+  // Lane recognizers are built alongside and must be ready before capture
+  // starts, so a lane's first chunk does not wait for one.
+  for (const auto& lane : session->lanes) {
+    const VoskApi* vosk = &state->vosk;
+    VoskModel* model = lane->model;
+    const RecognizerOptions options = lane->options;
+    lane->pending_recognizer = std::async(
+        session->start_mode == StartMode::kOverlapped ? std::launch::async : std::launch::deferred,
+        [vosk, model, options] { return CreateRecognizer(vosk, model, options).recognizer; });
+  }
+  if (session->second_pass != nullptr) {
+    const VoskApi* vosk = &state->vosk;
+    VoskModel* model = session->second_pass->model;
+    const float sample_rate = static_cast<float>(session->sample_rate);
+    session->second_pass->pending_recognizer = std::async(
+        session->start_mode == StartMode::kOverlapped ? std::launch::async : std::launch::deferred,
+        [vosk, model, sample_rate] {
+          VoskRecognizer* recognizer = vosk->NewRecognizer(model, sample_rate);
+          vosk->EnableWordTimings(recognizer);
+          return recognizer;
+        });
   }
-  state->vosk.EnableWordTimings(state->recognizer);
-  state->vosk.EnablePartialWords(state->recognizer, state->partial_results_enabled);
 
   PaStreamParameters input_params;
-  input_params.device = Pa_GetDefaultInputDevice();
+  // The device lock is never waited for under the plugin lock: an open that
+  // timed out may hold it for long, and cheap calls such as `stop` take the
+  // plugin lock on the platform thread.
+  lock.unlock();
+  std::unique_lock<std::mutex> device_lock(*state->device_mutex);
+  input_params.device = FindInputDevice(GetIntArg(options, "inputDeviceIndex", -1),
+                                        GetStringArg(options, "inputDeviceName"));
   if (input_params.device == paNoDevice) {
     std::ostringstream error;
-    error << "No default input device. Detected devices: " << ListAvailableInputDevices();
-    SendError(self, error.str(), true);
-    ReleaseRecognizerLocked(state);
+    error << "No matching input device. Detected devices: " << ListAvailableInputDevices();
+    device_lock.unlock();
+    SendListenError(self, handle_id, error.str());
+    DiscardPendingRecognizer(session.get());
     return SuccessBool(false);
   }
   const PaDeviceInfo* device_info = Pa_GetDeviceInfo(input_params.device);
@@ -992,75 +760,494 @@ static FlMethodResponse* HandleListen(SpeechToTextLinuxPlugin* self, FlValue* ar
   input_params.sampleFormat = paInt16;
   input_params.suggestedLatency = device_info != nullptr ? device_info->defaultLowInputLatency : 0.0;
   input_params.hostApiSpecificStreamInfo = nullptr;
-
-  state->frames_per_buffer = 1024;
+  device_lock.unlock();
+  lock.lock();
+  if (handle_id != 0) {
+    // `destroySession` may have run while the plugin lock was released.
+    auto found = state->handles.find(handle_id);
+    if (found == state->handles.end()) {
+      DiscardPendingRecognizer(session.get());
+      return MakeError("unknown_session", "No session with that id");
+    }
+    handle = found->second.get();
+  }
+
+  session->frames_per_buffer = 1024;
+  session->decode_buffer.resize(std::max<size_t>(
+      session->frames_per_buffer,
+      static_cast<size_t>(session->sample_rate) * kCatchUpBatchMillis / 1000));
+  session->drop_silence_when_behind = GetBoolArg(options, "dropSilenceWhenBehind", false);
+  if (state->scheduler == nullptr) {
+    const size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    state->scheduler.reset(new DecodeScheduler(
+        state->decode_threads > 0 ? static_cast<size_t>(state->decode_threads) : cores));
+    state->reactor.reset(new CaptureReactor());
+  }
+  // Room for a few seconds of audio in case decoding briefly falls behind.
+  session->ring.reset(new AudioRing(static_cast<size_t>(session->sample_rate) * 4));
+  const std::string journal_path = GetStringArg(options, "transcriptJournalPath");
+  if (!journal_path.empty()) {
+    std::unique_ptr<TranscriptJournal>& journal = state->journals[journal_path];
+    if (journal == nullptr) {
+      // The first session to use a journal picks its sync policy.
+      const std::string sync = GetStringArg(options, "transcriptJournalFsync");
+      const TranscriptJournal::SyncPolicy policy =
+          sync == "never"      ? TranscriptJournal::SyncPolicy::kNever
+          : sync == "interval" ? TranscriptJournal::SyncPolicy::kInterval
+                               : TranscriptJournal::SyncPolicy::kBatch;
+      journal.reset(new TranscriptJournal(
+          journal_path, policy,
+          std::chrono::milliseconds(std::max<gint64>(
+              GetIntArg(options, "transcriptJournalFsyncMillis", 1000), 1))));
+    }
+    session->journal = journal.get();
+  }
+  const std::string record_directory = GetStringArg(options, "recordDirectory");
+  if (!record_directory.empty()) {
+    g_mkdir_with_parents(record_directory.c_str(), 0755);
+    // Ten seconds of slack before a stalled disk costs audio.
+    std::shared_ptr<RecordingSink> sink =
+        std::make_shared<RecordingSink>(static_cast<size_t>(session->sample_rate) * 10);
+    const time_t now = time(nullptr);
+    struct tm local_time;
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime_r(&now, &local_time));
+    sink->prefix = record_directory + "/session-" + stamp + "-" + std::to_string(session->id);
+    sink->sample_rate = session->sample_rate;
+    const int64_t max_bytes = GetIntArg(options, "recordMaxBytes", 0);
+    const int64_t max_seconds = GetIntArg(options, "recordMaxSeconds", 0);
+    if (max_bytes > 0) {
+      sink->max_file_samples = std::max<int64_t>(
+          (max_bytes - static_cast<int64_t>(kWavHeaderBytes)) / 2, session->sample_rate / 10);
+    }
+    if (max_seconds > 0) {
+      const int64_t samples = max_seconds * session->sample_rate;
+      sink->max_file_samples =
+          sink->max_file_samples > 0 ? std::min(sink->max_file_samples, samples) : samples;
+    }
+    if (state->recorder == nullptr) {
+      state->recorder.reset(new SessionRecorder());
+    }
+    session->recording = std::move(sink);
+  }
+  // Registered before the lock is released, so a `stop` or `destroySession`
+  // during the open finds the session. It stays kStarting until the stream
+  // runs.
+  state->sessions.push_back(session);
+  if (handle_id == 0) {
+    state->current_session = session;
+    state->current_session_id.store(session->id);
+  } else {
+    handle->active = session;
+  }
+  if (self->control != nullptr) {
+    // Later cheap calls find the session now and need not wait for the open.
+    self->control->Settle();
+  }
   const PaStreamParameters params_copy = input_params;
   lock.unlock();
   auto open_result = OpenInputStreamWithTimeout(
-      params_copy, state->sample_rate, state->frames_per_buffer,
-      std::chrono::seconds(2));
+      state->device_mutex, params_copy, session->sample_rate, session->frames_per_buffer,
+      CaptureCallback, session.get(), std::chrono::seconds(2));
+  PaError start_error = paNoError;
+  if (!open_result.timed_out && open_result.error == paNoError) {
+    for (const auto& lane : session->lanes) {
+      lane->recognizer = lane->pending_recognizer.get();
+      if (lane->recognizer == nullptr) {
+        SendSessionError(self, session.get(), "Failed to create Vosk recognizer " + lane->name,
+                         false);
+      }
+    }
+    if (session->second_pass != nullptr) {
+      // Without it every segment keeps its first-pass final.
+      session->second_pass->recognizer = session->second_pass->pending_recognizer.get();
+      if (session->second_pass->recognizer == nullptr) {
+        SendSessionError(self, session.get(),
+                         "Failed to create Vosk recognizer for the second pass", false);
+      }
+    }
+    // Started before the plugin lock is taken again, see above. Its decode
+    // tasks only begin with StartDecoding.
+    session->stream = open_result.stream;
+    std::lock_guard<std::mutex> start_lock(*state->device_mutex);
+    start_error = Pa_StartStream(session->stream);
+    if (start_error != paNoError) {
+      Pa_CloseStream(session->stream);
+      session->stream = nullptr;
+    }
+  } else if (!open_result.timed_out && open_result.stream != nullptr) {
+    std::lock_guard<std::mutex> close_lock(*state->device_mutex);
+    Pa_CloseStream(open_result.stream);
+  }
   lock.lock();
   if (open_result.timed_out) {
     std::ostringstream error;
-    error << "Timed out while opening audio input. Detected devices: "
-          << ListAvailableInputDevices();
-    SendError(self, error.str(), true);
-    ReleaseRecognizerLocked(state);
+    error << "Timed out while opening audio input.";
+    // The stuck open may still hold the device.
+    if (device_lock.try_lock()) {
+      error << " Detected devices: " << ListAvailableInputDevices();
+      device_lock.unlock();
+    }
+    SendListenError(self, handle_id, error.str());
+    AbandonStartingSession(state, session.get());
     return SuccessBool(false);
   }
   if (open_result.error != paNoError) {
-    SendError(self, DescribePaError(open_result.error), true);
-    if (open_result.stream != nullptr) {
-      Pa_CloseStream(open_result.stream);
-    }
-    ReleaseRecognizerLocked(state);
+    SendListenError(self, handle_id, DescribePaError(open_result.error));
+    AbandonStartingSession(state, session.get());
     return SuccessBool(false);
   }
-  state->stream = open_result.stream;
-
-  const PaError start_error = Pa_StartStream(state->stream);
   if (start_error != paNoError) {
-    SendError(self, DescribePaError(start_error), true);
-    CloseStreamLocked(state);
-    ReleaseRecognizerLocked(state);
+    SendListenError(self, handle_id, DescribePaError(start_error));
+    AbandonStartingSession(state, session.get());
     return SuccessBool(false);
   }
 
-  state->stop_requested.store(false);
-  state->cancel_requested.store(false);
-  state->listening = true;
-  state->capture_thread_running = true;
-  state->capture_thread = std::thread(CaptureLoop, self);
+  // A stop during the open left the session in kStopping; its first decode
+  // task then winds it down like any stopped session.
+  session->MarkListening();
+  if (session->recording != nullptr) {
+    // Only now: a session that failed to start has nothing to write.
+    state->recorder->Add(session->recording);
+  }
+  StartDecoding(self, session.get());
+  int64_t active_sessions = 0;
+  for (const auto& running : state->sessions) {
+    active_sessions += running->capturing() ? 1 : 0;
+  }
 
-  SendStatus(self, "listening");
+  SendSessionStatus(self, session.get(), "listening");
+  {
+    const std::chrono::duration<double, std::milli> latency =
+        std::chrono::steady_clock::now() - tapped_at;
+    std::lock_guard<std::mutex> stats_lock(state->stats.mutex);
+    state->stats.tap_to_listening[static_cast<int>(session->start_mode)].Record(latency.count());
+    state->stats.peak_active_sessions =
+        std::max(state->stats.peak_active_sessions, active_sessions);
+  }
   DebugLog(self, "Listening started");
   return SuccessBool(true);
 }
 
-static FlMethodResponse* HandleStop(SpeechToTextLinuxPlugin* self, bool cancel) {
+// Only flags the session and wakes it; its decode task then stops the
+// stream, finalizes and tears everything down itself. The GTK thread never
+// waits on FinalResult or PortAudio here.
+static FlMethodResponse* HandleStop(PluginCore* self, FlValue* args,
+                                   bool cancel) {
   SpeechToTextLinuxPluginState* state = self->state;
   if (state == nullptr) {
     return SuccessNull();
   }
+  const auto called_at = std::chrono::steady_clock::now();
   {
     std::lock_guard<std::mutex> lock(state->mutex);
-    if (!state->listening) {
+    const int64_t handle_id = GetIntArg(args, "sessionId", 0);
+    RecognitionSession* session = state->current_session.get();
+    if (handle_id != 0) {
+      auto found = state->handles.find(handle_id);
+      if (found == state->handles.end()) {
+        return MakeError("unknown_session", "No session with that id");
+      }
+      session = found->second->active.get();
+    }
+    if (session == nullptr || !session->RequestStop(cancel, true, called_at)) {
       return SuccessNull();
     }
-    state->cancel_requested.store(cancel);
-    state->stop_requested.store(true);
   }
-  StopCaptureThread(state);
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - called_at;
+  std::lock_guard<std::mutex> lock(state->stats.mutex);
+  state->stats.stop_call.Record(elapsed.count());
+  return SuccessNull();
+}
+
+// Swaps the phrase list of a running session without restarting it.
+static FlMethodResponse* HandleSetGrammar(PluginCore* self, FlValue* args) {
+  SpeechToTextLinuxPluginState* state = self->state;
+  if (state == nullptr) {
+    return MakeError("state_unavailable", "Plugin state not initialized");
+  }
+  const std::string grammar =
+      BuildGrammarJson(LookupValue(args, "grammar"), GetBoolArg(args, "grammarUnknown", true));
+  std::lock_guard<std::mutex> lock(state->mutex);
+  if (!state->vosk.SupportsGrammarUpdate()) {
+    return MakeError("unsupported", "libvosk lacks vosk_recognizer_set_grm");
+  }
+  if (grammar.empty()) {
+    return MakeError("invalid_grammar", "grammar must list at least one phrase");
+  }
+  const int64_t handle_id = GetIntArg(args, "sessionId", 0);
+  RecognitionSession* session = state->current_session.get();
+  if (handle_id != 0) {
+    auto found = state->handles.find(handle_id);
+    session = found != state->handles.end() ? found->second->active.get() : nullptr;
+  }
+  if (session == nullptr || session->phase.load() != SessionPhase::kListening) {
+    return SuccessBool(false);
+  }
   {
-    std::lock_guard<std::mutex> lock(state->mutex);
-    CloseStreamLocked(state);
-    ReleaseRecognizerLocked(state);
-    state->listening = false;
+    std::lock_guard<std::mutex> grammar_lock(session->grammar_mutex);
+    session->pending_grammar = grammar;
+  }
+  session->grammar_changed.store(true);
+  session->waker.Notify();
+  return SuccessBool(true);
+}
+
+static FlMethodResponse* HandleCreateSession(PluginCore* self, FlValue* args) {
+  SpeechToTextLinuxPluginState* state = self->state;
+  if (state == nullptr) {
+    return MakeError("state_unavailable", "Plugin state not initialized");
+  }
+  std::lock_guard<std::mutex> lock(state->mutex);
+  std::unique_ptr<SessionHandle> handle(new SessionHandle());
+  // A copy: |args| belongs to this call, freed on whichever thread ran it.
+  handle->options = args != nullptr ? CopyValue(args) : nullptr;
+  const int64_t id = state->next_session_id++;
+  state->handles[id] = std::move(handle);
+  g_autoptr(FlValue) result = fl_value_new_int(id);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Cancels whatever the handle is capturing and forgets it. Its decode
+// task still tears down in the background.
+static FlMethodResponse* HandleDestroySession(PluginCore* self, FlValue* args) {
+  SpeechToTextLinuxPluginState* state = self->state;
+  if (state == nullptr) {
+    return SuccessNull();
+  }
+  std::lock_guard<std::mutex> lock(state->mutex);
+  auto found = state->handles.find(GetIntArg(args, "sessionId", 0));
+  if (found == state->handles.end()) {
+    return SuccessNull();
   }
+  RecognitionSession* session = found->second->active.get();
+  if (session != nullptr) {
+    session->RequestStop(true, false, std::chrono::steady_clock::now());
+  }
+  state->handles.erase(found);
   return SuccessNull();
 }
 
-static FlMethodResponse* HandleLocales(SpeechToTextLinuxPlugin* self) {
+static FlMethodResponse* HandleInputDevices(PluginCore* self) {
+  g_autoptr(FlValue) devices = fl_value_new_list();
+  SpeechToTextLinuxPluginState* state = self->state;
+  if (state == nullptr) {
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(devices));
+  }
+  if (state->WaitForPortAudio() != paNoError) {
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(devices));
+  }
+  std::lock_guard<std::mutex> device_lock(*state->device_mutex);
+  const PaDeviceIndex default_device = Pa_GetDefaultInputDevice();
+  const PaDeviceIndex count = Pa_GetDeviceCount();
+  for (PaDeviceIndex i = 0; i < count; ++i) {
+    const PaDeviceInfo* info = Pa_GetDeviceInfo(i);
+    if (info == nullptr || info->maxInputChannels <= 0) {
+      continue;
+    }
+    FlValue* device = fl_value_new_map();
+    fl_value_set_string_take(device, "index", fl_value_new_int(i));
+    fl_value_set_string_take(device, "name",
+                             fl_value_new_string(info->name != nullptr ? info->name : ""));
+    fl_value_set_string_take(device, "channels", fl_value_new_int(info->maxInputChannels));
+    fl_value_set_string_take(device, "defaultSampleRate",
+                             fl_value_new_float(info->defaultSampleRate));
+    fl_value_set_string_take(device, "isDefault", fl_value_new_bool(i == default_device));
+    fl_value_append_take(devices, device);
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(devices));
+}
+
+static FlValue* LatencyStatToValue(const LatencyStat& stat) {
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "count", fl_value_new_int(stat.count));
+  fl_value_set_string_take(
+      value, "avgMs",
+      fl_value_new_float(stat.count > 0 ? stat.total_ms / static_cast<double>(stat.count) : 0.0));
+  fl_value_set_string_take(value, "maxMs", fl_value_new_float(stat.max_ms));
+  fl_value_set_string_take(value, "lastMs", fl_value_new_float(stat.last_ms));
+  return value;
+}
+
+static FlMethodResponse* HandleStats(PluginCore* self) {
+  g_autoptr(FlValue) result = fl_value_new_map();
+  if (self->state != nullptr) {
+    SpeechToTextLinuxPluginState* state = self->state;
+    std::lock_guard<std::mutex> state_lock(state->mutex);
+    PipelineStats& stats = state->stats;
+    std::lock_guard<std::mutex> lock(stats.mutex);
+    int64_t active_sessions = 0;
+    FlValue* session_delays = fl_value_new_list();
+    FlValue* session_load = fl_value_new_list();
+    for (const auto& session : state->sessions) {
+      if (!session->capturing()) {
+        continue;
+      }
+      active_sessions++;
+      FlValue* delay = LatencyStatToValue(session->queue_delay);
+      fl_value_set_string_take(delay, "sessionId", fl_value_new_int(session->id));
+      fl_value_append_take(session_delays, delay);
+      FlValue* load = fl_value_new_map();
+      fl_value_set_string_take(load, "sessionId", fl_value_new_int(session->id));
+      fl_value_set_string_take(load, "realTimeFactor",
+                               fl_value_new_float(session->real_time_factor.load()));
+      fl_value_set_string_take(load, "decodeLevel",
+                               fl_value_new_int(session->decode_level.load()));
+      fl_value_set_string_take(
+          load, "backlogMillis",
+          fl_value_new_float(static_cast<double>(session->backlog_samples.load()) * 1000.0 /
+                             session->sample_rate));
+      fl_value_append_take(session_load, load);
+    }
+    fl_value_set_string_take(result, "decodeThreads",
+                             fl_value_new_int(state->scheduler != nullptr
+                                                  ? static_cast<int64_t>(
+                                                        state->scheduler->worker_count())
+                                                  : 0));
+    fl_value_set_string_take(result, "decodeQueueDelay",
+                             LatencyStatToValue(stats.decode_queue_delay));
+    fl_value_set_string_take(result, "sessionQueueDelay", session_delays);
+    fl_value_set_string_take(result, "sessionLoad", session_load);
+    fl_value_set_string_take(result, "downgrades", fl_value_new_int(stats.downgrades));
+    fl_value_set_string_take(result, "restores", fl_value_new_int(stats.restores));
+    fl_value_set_string_take(result, "catchUpEvents", fl_value_new_int(stats.catch_up_events));
+    fl_value_set_string_take(result, "peakBacklogMillis",
+                             fl_value_new_float(stats.peak_backlog_ms));
+    fl_value_set_string_take(result, "catchUpSkippedSeconds",
+                             fl_value_new_float(stats.catch_up_skipped_seconds));
+    fl_value_set_string_take(result, "overflowSeconds",
+                             fl_value_new_float(stats.overflow_seconds));
+    fl_value_set_string_take(result, "chunkPoolMisses",
+                             fl_value_new_int(stats.chunk_pool_misses));
+    fl_value_set_string_take(
+        result, "eventQueueOverflows",
+        fl_value_new_int(self->events != nullptr ? self->events->overflows() : 0));
+    fl_value_set_string_take(result, "laneDroppedChunks",
+                             fl_value_new_int(stats.lane_dropped_chunks));
+    fl_value_set_string_take(result, "languagePicks", fl_value_new_int(stats.language_picks));
+    fl_value_set_string_take(result, "earlyDrops", fl_value_new_int(stats.early_drops));
+    fl_value_set_string_take(result, "secondPassLatency",
+                             LatencyStatToValue(stats.second_pass_latency));
+    fl_value_set_string_take(result, "secondPassFallbacks",
+                             fl_value_new_int(stats.second_pass_fallbacks));
+    fl_value_set_string_take(result, "continuousSegments",
+                             fl_value_new_int(stats.continuous_segments));
+    fl_value_set_string_take(result, "standbyDetections",
+                             fl_value_new_int(stats.standby_detections));
+    fl_value_set_string_take(result, "standbyAudioSeconds",
+                             fl_value_new_float(stats.standby_audio_seconds));
+    fl_value_set_string_take(result, "standbyDecodedSeconds",
+                             fl_value_new_float(stats.standby_decoded_seconds));
+    fl_value_set_string_take(result, "standbyCpuSeconds",
+                             fl_value_new_float(stats.standby_cpu_seconds));
+    // Process memory, so soak runs can check that it stays flat.
+    fl_value_set_string_take(result, "rssKb", fl_value_new_int(ReadProcStatusKb("VmRSS")));
+    fl_value_set_string_take(result, "peakRssKb", fl_value_new_int(ReadProcStatusKb("VmHWM")));
+    fl_value_set_string_take(result, "endOfSpeechToFinal",
+                             LatencyStatToValue(stats.end_of_speech_to_final));
+    fl_value_set_string_take(result, "stopToStatus", LatencyStatToValue(stats.stop_to_status));
+    fl_value_set_string_take(result, "stopCall", LatencyStatToValue(stats.stop_call));
+    const char* start_modes[] = {"overlappedStart", "sequentialStart"};
+    for (int mode = 0; mode < kStartModeCount; ++mode) {
+      FlValue* start = fl_value_new_map();
+      fl_value_set_string_take(start, "tapToListening",
+                               LatencyStatToValue(stats.tap_to_listening[mode]));
+      fl_value_set_string_take(start, "tapToFirstResult",
+                               LatencyStatToValue(stats.tap_to_first_result[mode]));
+      fl_value_set_string_take(result, start_modes[mode], start);
+    }
+    fl_value_set_string_take(result, "acousticEndpoints",
+                             fl_value_new_int(stats.acoustic_endpoints));
+    fl_value_set_string_take(result, "voskEndpoints", fl_value_new_int(stats.vosk_endpoints));
+    fl_value_set_string_take(result, "pauseTimeouts", fl_value_new_int(stats.pause_timeouts));
+    fl_value_set_string_take(result, "listenTimeouts", fl_value_new_int(stats.listen_timeouts));
+    fl_value_set_string_take(result, "pooledRecognizers",
+                             fl_value_new_int(stats.pooled_recognizers));
+    fl_value_set_string_take(result, "activeSessions", fl_value_new_int(active_sessions));
+    fl_value_set_string_take(result, "peakActiveSessions",
+                             fl_value_new_int(stats.peak_active_sessions));
+    fl_value_set_string_take(result, "decodedAudioSeconds",
+                             fl_value_new_float(stats.decoded_audio_seconds));
+    fl_value_set_string_take(result, "decodeCpuSeconds",
+                             fl_value_new_float(stats.decode_cpu_seconds));
+    // Real-time streams one core can keep up with, from finished sessions.
+    fl_value_set_string_take(
+        result, "sessionsPerCore",
+        fl_value_new_float(stats.decode_cpu_seconds > 0.0
+                               ? stats.decoded_audio_seconds / stats.decode_cpu_seconds
+                               : 0.0));
+    // Keyed by `maxAlternatives`; compare realTimeFactor against "0".
+    FlValue* by_alternatives = fl_value_new_map();
+    for (const auto& entry : stats.decode_cost_by_alternatives) {
+      FlValue* cost = fl_value_new_map();
+      fl_value_set_string_take(cost, "audioSeconds",
+                               fl_value_new_float(entry.second.audio_seconds));
+      fl_value_set_string_take(cost, "cpuSeconds", fl_value_new_float(entry.second.cpu_seconds));
+      fl_value_set_string_take(
+          cost, "realTimeFactor",
+          fl_value_new_float(entry.second.audio_seconds > 0.0
+                                 ? entry.second.cpu_seconds / entry.second.audio_seconds
+                                 : 0.0));
+      fl_value_set_string_take(by_alternatives, std::to_string(entry.first).c_str(), cost);
+    }
+    fl_value_set_string_take(result, "decodeCostByAlternatives", by_alternatives);
+    fl_value_set_string_take(result, "mainThreadCpuSeconds",
+                             fl_value_new_float(stats.main_thread_cpu_seconds));
+    fl_value_set_string_take(result, "controlCpuSeconds",
+                             fl_value_new_float(stats.control_cpu_seconds));
+    fl_value_set_string_take(result, "controlQueueDelay",
+                             LatencyStatToValue(stats.control_queue_delay));
+    fl_value_set_string_take(result, "portAudioInitMillis",
+                             fl_value_new_float(StartupMillis(state->port_audio)));
+    fl_value_set_string_take(result, "portAudioWait", LatencyStatToValue(stats.port_audio_wait));
+    if (!state->journals.empty()) {
+      int64_t lines = 0;
+      int64_t bytes = 0;
+      int64_t syncs = 0;
+      int64_t errors = 0;
+      for (const auto& entry : state->journals) {
+        lines += entry.second->lines_written();
+        bytes += entry.second->bytes_written();
+        syncs += entry.second->syncs();
+        errors += entry.second->errors();
+      }
+      fl_value_set_string_take(result, "journalLines", fl_value_new_int(lines));
+      fl_value_set_string_take(result, "journalBytesWritten", fl_value_new_int(bytes));
+      fl_value_set_string_take(result, "journalSyncs", fl_value_new_int(syncs));
+      fl_value_set_string_take(result, "journalErrors", fl_value_new_int(errors));
+    }
+    if (state->recorder != nullptr) {
+      const SessionRecorder& recorder = *state->recorder;
+      fl_value_set_string_take(result, "recordingBytesWritten",
+                               fl_value_new_int(recorder.bytes_written()));
+      fl_value_set_string_take(result, "recordingFiles", fl_value_new_int(recorder.files()));
+      fl_value_set_string_take(result, "recordingErrors", fl_value_new_int(recorder.errors()));
+      fl_value_set_string_take(result, "recordingQueueMillis",
+                               fl_value_new_int(recorder.queued_ms()));
+      fl_value_set_string_take(result, "recordingPeakQueueMillis",
+                               fl_value_new_int(recorder.peak_queued_ms()));
+      fl_value_set_string_take(result, "recordingDroppedMillis",
+                               fl_value_new_int(recorder.dropped_ms()));
+    }
+    fl_value_set_string_take(result, "registrationMillis",
+                             fl_value_new_float(stats.registration_ms));
+    fl_value_set_string_take(result, "enginePreloadMillis",
+                             fl_value_new_float(StartupMillis(state->vosk_preload)));
+    fl_value_set_string_take(result, "timeToFirstRecognitionMillis",
+                             fl_value_new_float(stats.first_recognition_ms));
+    // Share of the plugin's CPU time spent on the platform thread.
+    const double plugin_cpu = stats.main_thread_cpu_seconds + stats.control_cpu_seconds +
+                              stats.decode_cpu_seconds;
+    fl_value_set_string_take(
+        result, "mainThreadCpuShare",
+        fl_value_new_float(plugin_cpu > 0.0 ? stats.main_thread_cpu_seconds / plugin_cpu
+                                            : 0.0));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+static FlMethodResponse* HandleLocales(PluginCore* self) {
   g_autoptr(FlValue) locales = fl_value_new_list();
   if (self->state != nullptr) {
     std::lock_guard<std::mutex> lock(self->state->mutex);
@@ -1072,12 +1259,9 @@ static FlMethodResponse* HandleLocales(SpeechToTextLinuxPlugin* self) {
   return FL_METHOD_RESPONSE(fl_method_success_response_new(locales));
 }
 
-static void speech_to_text_linux_plugin_handle_method_call(
-    SpeechToTextLinuxPlugin* self, FlMethodCall* method_call) {
-  const gchar* method = fl_method_call_get_name(method_call);
-  FlValue* args = fl_method_call_get_args(method_call);
-  g_autoptr(FlMethodResponse) response = nullptr;
-
+static FlMethodResponse* HandleMethod(PluginCore* self, const gchar* method,
+                                      FlValue* args) {
+  FlMethodResponse* response = nullptr;
   if (strcmp(method, "hasPermission") == 0) {
     response = HandleHasPermission();
   } else if (strcmp(method, "initialize") == 0) {
@@ -1085,31 +1269,147 @@ static void speech_to_text_linux_plugin_handle_method_call(
   } else if (strcmp(method, "listen") == 0) {
     response = HandleListen(self, args);
   } else if (strcmp(method, "stop") == 0) {
-    response = HandleStop(self, false);
+    response = HandleStop(self, args, false);
   } else if (strcmp(method, "cancel") == 0) {
-    response = HandleStop(self, true);
+    response = HandleStop(self, args, true);
+  } else if (strcmp(method, "setGrammar") == 0) {
+    response = HandleSetGrammar(self, args);
+  } else if (strcmp(method, "createSession") == 0) {
+    response = HandleCreateSession(self, args);
+  } else if (strcmp(method, "destroySession") == 0) {
+    response = HandleDestroySession(self, args);
+  } else if (strcmp(method, "inputDevices") == 0) {
+    response = HandleInputDevices(self);
   } else if (strcmp(method, "locales") == 0) {
     response = HandleLocales(self);
+  } else if (strcmp(method, "stats") == 0) {
+    response = HandleStats(self);
   } else {
     response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
   }
+  return response;
+}
 
-  fl_method_call_respond(method_call, response, nullptr);
+// A response computed by the control worker, sent from the main context.
+// Holds the core until the response is sent, so the last reference may be
+// dropped on the platform thread; MakePluginCore's deleter keeps that cheap.
+struct PendingResponse {
+  std::shared_ptr<PluginCore> core;
+  FlMethodCall* call;
+  FlMethodResponse* response;
+};
+
+static gboolean RespondOnMain(gpointer user_data) {
+  PendingResponse* pending = static_cast<PendingResponse*>(user_data);
+  const double cpu_started = ThreadCpuSeconds();
+  fl_method_call_respond(pending->call, pending->response, nullptr);
+  RecordMainThreadCpu(pending->core.get(), cpu_started);
+  return G_SOURCE_REMOVE;
+}
+
+static void FreePendingResponse(gpointer user_data) {
+  PendingResponse* pending = static_cast<PendingResponse*>(user_data);
+  g_object_unref(pending->response);
+  g_object_unref(pending->call);
+  delete pending;
 }
 
+// Runs on a control worker thread, or inline for a cheap call.
+static void RunMethodCall(const std::shared_ptr<PluginCore>& core, FlMethodCall* method_call,
+                          FlValue* args, std::chrono::steady_clock::time_point queued_at) {
+  PluginCore* self = core.get();
+  const auto started = std::chrono::steady_clock::now();
+  const double cpu_started = ThreadCpuSeconds();
+  FlMethodResponse* response = HandleMethod(self, fl_method_call_get_name(method_call), args);
+  {
+    const std::chrono::duration<double, std::milli> delay = started - queued_at;
+    std::lock_guard<std::mutex> lock(self->state->stats.mutex);
+    self->state->stats.control_queue_delay.Record(delay.count());
+    self->state->stats.control_cpu_seconds += ThreadCpuSeconds() - cpu_started;
+  }
+  PendingResponse* pending = new PendingResponse{
+      core, static_cast<FlMethodCall*>(g_object_ref(method_call)), response};
+  g_main_context_invoke_full(self->main_context, G_PRIORITY_DEFAULT, RespondOnMain, pending,
+                             FreePendingResponse);
+}
+
+// Calls that load models, build recognizers or wait for PortAudio.
+static bool IsBlockingMethod(const gchar* method) {
+  return strcmp(method, "initialize") == 0 || strcmp(method, "listen") == 0 ||
+         strcmp(method, "inputDevices") == 0;
+}
+
+}  // namespace speech_to_text_linux
+
+using speech_to_text_linux::ControlWorker;
+using speech_to_text_linux::CopyValue;
+using speech_to_text_linux::DispatchEvents;
+using speech_to_text_linux::EventQueue;
+using speech_to_text_linux::IsBlockingMethod;
+using speech_to_text_linux::MakeError;
+using speech_to_text_linux::MakePluginCore;
+using speech_to_text_linux::PluginCore;
+using speech_to_text_linux::RecordMainThreadCpu;
+using speech_to_text_linux::RunMethodCall;
+using speech_to_text_linux::SpeechToTextLinuxPluginState;
+using speech_to_text_linux::ThreadCpuSeconds;
+using speech_to_text_linux::event_source_funcs;
+using speech_to_text_linux::kEventQueueSlots;
+
+struct _SpeechToTextLinuxPlugin {
+  GObject parent_instance;
+  // Shared with the method calls in flight; released by dispose.
+  std::shared_ptr<speech_to_text_linux::PluginCore>* core;
+};
+
+G_DEFINE_TYPE(SpeechToTextLinuxPlugin, speech_to_text_linux_plugin, g_object_get_type())
+
+// Blocking calls are only handed over: the platform thread never waits for
+// a model to load or a device to open. Cheap ones may run right here; they
+// hold the plugin lock only briefly, as does everything else.
+static void speech_to_text_linux_plugin_handle_method_call(
+    SpeechToTextLinuxPlugin* plugin, FlMethodCall* method_call) {
+  const std::shared_ptr<PluginCore>& core = *plugin->core;
+  const double cpu_started = ThreadCpuSeconds();
+  const gchar* method = fl_method_call_get_name(method_call);
+  std::shared_ptr<FlMethodCall> call(static_cast<FlMethodCall*>(g_object_ref(method_call)),
+                                     g_object_unref);
+  std::shared_ptr<FlValue> args(CopyValue(fl_method_call_get_args(method_call)),
+                                fl_value_unref);
+  const auto queued_at = std::chrono::steady_clock::now();
+  ControlWorker::Job job;
+  job.run = [core, call, args, queued_at]() {
+    RunMethodCall(core, call.get(), args.get(), queued_at);
+  };
+  // Only ever run on the platform thread, by dispose.
+  job.drop = [call]() {
+    g_autoptr(FlMethodResponse) response =
+        MakeError("disposed", "The plugin was disposed before the call ran");
+    fl_method_call_respond(call.get(), response, nullptr);
+  };
+  if (IsBlockingMethod(method)) {
+    core->control->PostBlocking(std::move(job));
+  } else {
+    core->control->PostCheap(std::move(job));
+  }
+  RecordMainThreadCpu(core.get(), cpu_started);
+}
+
+// Never waits: calls in progress keep the core alive, and the last
+// reference tears it down off the platform thread.
 static void speech_to_text_linux_plugin_dispose(GObject* object) {
   SpeechToTextLinuxPlugin* self = SPEECH_TO_TEXT_LINUX_PLUGIN(object);
-  if (self->state != nullptr) {
-    StopCaptureThread(self->state);
-    delete self->state;
-    self->state = nullptr;
-  }
-  if (self->channel != nullptr) {
-    g_clear_object(&self->channel);
-  }
-  if (self->main_context != nullptr) {
-    g_main_context_unref(self->main_context);
-    self->main_context = nullptr;
+  if (self->core != nullptr) {
+    PluginCore* core = self->core->get();
+    // Queued calls are answered here, on the platform thread, with an
+    // error; the running ones finish on their workers.
+    core->control->Shutdown();
+    // Nothing is dispatched any more; wake-ups of a destroyed source are
+    // no-ops.
+    g_source_destroy(core->event_source);
+    g_clear_object(&core->channel);
+    delete self->core;
+    self->core = nullptr;
   }
   G_OBJECT_CLASS(speech_to_text_linux_plugin_parent_class)->dispose(object);
 }
@@ -1119,9 +1419,18 @@ static void speech_to_text_linux_plugin_class_init(SpeechToTextLinuxPluginClass*
 }
 
 static void speech_to_text_linux_plugin_init(SpeechToTextLinuxPlugin* self) {
-  self->state = new SpeechToTextLinuxPluginState();
-  self->channel = nullptr;
-  self->main_context = g_main_context_ref_thread_default();
+  self->core = new std::shared_ptr<PluginCore>(MakePluginCore());
+  PluginCore* core = self->core->get();
+  core->state = new SpeechToTextLinuxPluginState();
+  core->main_context = g_main_context_ref_thread_default();
+  core->events = new EventQueue(kEventQueueSlots);
+  core->event_source = g_source_new(&event_source_funcs, sizeof(GSource));
+  // The source is destroyed by dispose, before the core can go away.
+  g_source_set_callback(core->event_source, DispatchEvents, core, nullptr);
+  g_source_attach(core->event_source, core->main_context);
+  core->control = new ControlWorker();
+  core->state->StartPortAudio();
+  core->state->StartVoskPreload();
 }
 
 static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
@@ -1131,6 +1440,7 @@ static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
 }
 
 void speech_to_text_linux_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+  const auto started = std::chrono::steady_clock::now();
   SpeechToTextLinuxPlugin* plugin = SPEECH_TO_TEXT_LINUX_PLUGIN(
       g_object_new(speech_to_text_linux_plugin_get_type(), nullptr));
 
@@ -1138,10 +1448,17 @@ void speech_to_text_linux_plugin_register_with_registrar(FlPluginRegistrar* regi
   g_autoptr(FlMethodChannel) channel =
       fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
                             "speech_to_text_linux", FL_METHOD_CODEC(codec));
-  plugin->channel = FL_METHOD_CHANNEL(g_object_ref(channel));
+  PluginCore* core = plugin->core->get();
+  core->channel = FL_METHOD_CHANNEL(g_object_ref(channel));
 
   fl_method_channel_set_method_call_handler(channel, method_call_cb,
                                             g_object_ref(plugin), g_object_unref);
+  {
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - started;
+    std::lock_guard<std::mutex> lock(core->state->stats.mutex);
+    core->state->stats.registration_ms = elapsed.count();
+  }
 
   g_object_unref(plugin);
 }
@@ -0,0 +1,320 @@
+// Checks that the per-chunk paths of the plugin stop allocating once warmed
+// up: the event queue, the audio chunk pool, result payloads and a session's
+// decode slice, run against stub Vosk entry points. Every operator new and
+// malloc call on the test thread is counted while a check is armed.
+//
+// Built with -DSPEECH_TO_TEXT_LINUX_TESTS=ON and run by ctest.
+
+#include <glib.h>
+#include <malloc.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "../audio_capture.h"
+#include "../decode_pipeline.h"
+#include "../event_queue.h"
+#include "../json_payloads.h"
+#include "../plugin_state.h"
+#include "../recognition_session.h"
+#include "../vosk_api.h"
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+extern "C" void* __libc_memalign(size_t alignment, size_t size);
+extern "C" void __libc_free(void* pointer);
+
+using speech_to_text_linux::Alternative;
+using speech_to_text_linux::AudioChunk;
+using speech_to_text_linux::AudioChunkRef;
+using speech_to_text_linux::AudioRing;
+using speech_to_text_linux::AudioSpan;
+using speech_to_text_linux::BuildRecognitionPayload;
+using speech_to_text_linux::BuildSessionSoundLevelJson;
+using speech_to_text_linux::ChunkPool;
+using speech_to_text_linux::DecodeSlice;
+using speech_to_text_linux::EventQueue;
+using speech_to_text_linux::kCatchUpBatchMillis;
+using speech_to_text_linux::kEventQueueSlots;
+using speech_to_text_linux::PluginCore;
+using speech_to_text_linux::RecognitionSession;
+using speech_to_text_linux::SpeechToTextLinuxPluginState;
+using speech_to_text_linux::VoskApi;
+using speech_to_text_linux::VoskModel;
+using speech_to_text_linux::VoskRecognizer;
+
+namespace {
+
+// Only the test thread's allocations count, and only while armed.
+thread_local bool tracking = false;
+thread_local int64_t allocations = 0;
+
+void CountAllocation() {
+  if (tracking) {
+    allocations++;
+  }
+}
+
+}  // namespace
+
+extern "C" void* malloc(size_t size) {
+  CountAllocation();
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+  CountAllocation();
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) {
+  CountAllocation();
+  return __libc_realloc(pointer, size);
+}
+
+extern "C" void* memalign(size_t alignment, size_t size) {
+  CountAllocation();
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" void free(void* pointer) {
+  __libc_free(pointer);
+}
+
+void* operator new(size_t size) {
+  CountAllocation();
+  void* pointer = __libc_malloc(size > 0 ? size : 1);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  CountAllocation();
+  return __libc_malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void* pointer) noexcept {
+  __libc_free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+  __libc_free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+  __libc_free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+  __libc_free(pointer);
+}
+
+namespace {
+
+constexpr int kWarmUpRounds = 4;
+constexpr int kSteadyRounds = 2000;
+
+// Runs |round| kWarmUpRounds times untracked, then kSteadyRounds times
+// tracked, and reports any allocation in the second phase.
+template <typename Round>
+bool ExpectNoAllocations(const char* name, Round round) {
+  for (int i = 0; i < kWarmUpRounds; ++i) {
+    round();
+  }
+  allocations = 0;
+  tracking = true;
+  for (int i = 0; i < kSteadyRounds; ++i) {
+    round();
+  }
+  tracking = false;
+  if (allocations != 0) {
+    fprintf(stderr, "FAILED %s: %lld allocations in %d rounds\n", name,
+            static_cast<long long>(allocations), kSteadyRounds);
+    return false;
+  }
+  printf("ok %s\n", name);
+  return true;
+}
+
+bool TestEventQueue() {
+  EventQueue queue(kEventQueueSlots);
+  std::string payload;
+  BuildSessionSoundLevelJson(&payload, 12, 3, -41.5);
+  const std::string partial(180, 'x');
+  // A burst of partials and sound levels the platform thread drains late,
+  // as while it is busy drawing.
+  return ExpectNoAllocations("EventQueue", [&] {
+    for (size_t i = 0; i < kEventQueueSlots / 2; ++i) {
+      queue.Post("soundLevelChange", nullptr, -30.0);
+      queue.Post("textRecognition", i % 2 == 0 ? &partial : &payload, 0.0);
+    }
+    while (queue.Pop() != nullptr) {
+    }
+  });
+}
+
+bool TestChunkPool() {
+  ChunkPool pool;
+  std::vector<AudioChunkRef> published;
+  published.reserve(16);
+  return ExpectNoAllocations("ChunkPool", [&] {
+    // A session's decoder, a lane and a second-pass segment each hold
+    // references for a while before dropping them.
+    for (int i = 0; i < 16; ++i) {
+      std::shared_ptr<AudioChunk> chunk = pool.Take();
+      chunk->samples.resize(1024);
+      chunk->first_sample = i * 1024;
+      published.push_back(std::move(chunk));
+    }
+    AudioChunkRef lane_copy = published.front();
+    published.clear();
+  });
+}
+
+bool TestRecognitionPayload() {
+  std::string out;
+  const std::string text("open the settings page and turn on dark mode");
+  const std::string recognizer("commands");
+  AudioSpan span;
+  span.start_ms = 1234567.25;
+  span.end_ms = 1236789.5;
+  std::vector<Alternative> alternates(3);
+  for (size_t i = 0; i < alternates.size(); ++i) {
+    alternates[i].text = text;
+    alternates[i].confidence = 0.5 / static_cast<double>(i + 1);
+  }
+  return ExpectNoAllocations("BuildRecognitionPayload", [&] {
+    BuildRecognitionPayload(&out, text, -1.0, false, 12, 3, recognizer, span);
+    BuildRecognitionPayload(&out, text, 0.875, true, 12, 0, recognizer, AudioSpan());
+    BuildRecognitionPayload(&out, text, 0.5, true, 12, 3, recognizer, span, &alternates);
+  });
+}
+
+// Stub libvosk: the recognizer never finalizes and its partial alternates
+// between two hypotheses, so every buffer delivers a new partial.
+int stub_recognizer_storage = 0;
+int stub_partials = 0;
+
+VoskModel* StubModelNew(const char*) {
+  return reinterpret_cast<VoskModel*>(&stub_recognizer_storage);
+}
+
+void StubModelFree(VoskModel*) {}
+
+VoskRecognizer* StubRecognizerNew(VoskModel*, float) {
+  return reinterpret_cast<VoskRecognizer*>(&stub_recognizer_storage);
+}
+
+void StubRecognizerFree(VoskRecognizer*) {}
+
+int StubAcceptWaveform(VoskRecognizer*, const char*, int) {
+  return 0;
+}
+
+const char* StubResult(VoskRecognizer*) {
+  return "{\n  \"text\" : \"\"\n}";
+}
+
+const char* StubPartialResult(VoskRecognizer*) {
+  return ++stub_partials % 2 == 0
+             ? "{\n  \"partial\" : \"open the settings page\"\n}"
+             : "{\n  \"partial\" : \"open the settings page and\"\n}";
+}
+
+void StubRecognizerReset(VoskRecognizer*) {}
+
+VoskApi::Functions StubVosk() {
+  VoskApi::Functions functions;
+  functions.model_new = StubModelNew;
+  functions.model_free = StubModelFree;
+  functions.recognizer_new = StubRecognizerNew;
+  functions.recognizer_free = StubRecognizerFree;
+  functions.recognizer_accept = StubAcceptWaveform;
+  functions.recognizer_result = StubResult;
+  functions.recognizer_partial = StubPartialResult;
+  functions.recognizer_final = StubResult;
+  functions.recognizer_reset = StubRecognizerReset;
+  return functions;
+}
+
+GSourceFuncs no_dispatch_funcs = {};
+
+// Feeds one device buffer at a time through a session's decode slice, as
+// the capture callback and the decode task do, and drains the events the
+// platform thread would send. |handle_id| picks the session-tagged
+// callbacks over the legacy ones.
+bool TestDecodeSlice(const char* name, int64_t handle_id) {
+  PluginCore core;
+  core.state = new SpeechToTextLinuxPluginState();
+  core.events = new EventQueue(kEventQueueSlots);
+  core.event_source = g_source_new(&no_dispatch_funcs, sizeof(GSource));
+  SpeechToTextLinuxPluginState* state = core.state;
+  if (!state->vosk.Bind(StubVosk())) {
+    fprintf(stderr, "FAILED %s: %s\n", name, state->vosk.last_error().c_str());
+    return false;
+  }
+
+  RecognitionSession session(1, &state->vosk, state->device_mutex);
+  session.handle_id = handle_id;
+  session.recognizer = state->vosk.NewRecognizer(state->vosk.NewModel(""), 16000.0f);
+  session.stream_origin_ns.store(1000000000);
+  session.decode_buffer.resize(
+      static_cast<size_t>(session.sample_rate) * kCatchUpBatchMillis / 1000);
+  session.ring.reset(new AudioRing(static_cast<size_t>(session.sample_rate) * 4));
+  session.endpointer.Configure(session.sample_rate, std::chrono::milliseconds(0), 12.0);
+  session.ResetRecognitionTimers();
+  state->current_session_id.store(handle_id == 0 ? session.id : 0);
+
+  // A 440 Hz tone, loud enough to count as speech.
+  std::vector<int16_t> buffer(session.frames_per_buffer);
+  for (size_t i = 0; i < buffer.size(); ++i) {
+    buffer[i] = static_cast<int16_t>(
+        8000.0 * std::sin(2.0 * M_PI * 440.0 * static_cast<double>(i) / session.sample_rate));
+  }
+  int64_t delivered = 0;
+  const bool passed = ExpectNoAllocations(name, [&] {
+    session.ring->Write(buffer.data(), buffer.size());
+    if (!DecodeSlice(&core, &session)) {
+      return;
+    }
+    while (core.events->Pop() != nullptr) {
+      delivered++;
+    }
+  });
+  // Each buffer sends its sound level and a new partial.
+  const int64_t expected = 2 * (kWarmUpRounds + kSteadyRounds);
+  if (passed && delivered != expected) {
+    fprintf(stderr, "FAILED %s: %lld events, expected %lld\n", name,
+            static_cast<long long>(delivered), static_cast<long long>(expected));
+    return false;
+  }
+  return passed;
+}
+
+}  // namespace
+
+int main() {
+  bool passed = true;
+  passed &= TestEventQueue();
+  passed &= TestChunkPool();
+  passed &= TestRecognitionPayload();
+  passed &= TestDecodeSlice("DecodeSlice", 0);
+  passed &= TestDecodeSlice("DecodeSlice (handle session)", 7);
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,350 @@
+// Soak benchmark for continuous dictation: loops a recording through a
+// continuous RecognitionSession, one device buffer at a time, through the
+// same decode slice the decode tasks run. Every endpoint closes a segment
+// with EndSegment, which resets the recognizer in place; finals go to a
+// transcript journal with their word timings. The test checks that resident
+// memory stays flat. Audio is fed as fast as the recognizers take it, so an
+// hour of audio takes minutes.
+//
+// Needs a model and a 16-bit mono WAV file with speech:
+//   SPEECH_TO_TEXT_SOAK_MODEL       Vosk model directory
+//   SPEECH_TO_TEXT_SOAK_WAV         recording to loop
+//   SPEECH_TO_TEXT_SOAK_SECONDS     audio to decode (default 7200)
+//   SPEECH_TO_TEXT_SOAK_MODE        `continuous` (default), `race` to pick
+//                                   between the session's recognizer and a
+//                                   lane, or `second-pass` to re-decode
+//                                   every segment; both use the same model
+//   SPEECH_TO_TEXT_SOAK_VOSK        libvosk path, if not on the search path
+// Without the first two it reports itself as skipped.
+
+#include <flutter_linux/flutter_linux.h>
+#include <glib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../decode_pipeline.h"
+#include "../event_queue.h"
+#include "../plugin_state.h"
+#include "../recognition_session.h"
+#include "../session_output.h"
+#include "../vosk_api.h"
+
+using speech_to_text_linux::AudioRing;
+using speech_to_text_linux::CreateRecognizer;
+using speech_to_text_linux::DecodeScheduler;
+using speech_to_text_linux::DecodeSlice;
+using speech_to_text_linux::EventQueue;
+using speech_to_text_linux::kCatchUpBatchMillis;
+using speech_to_text_linux::kEventQueueSlots;
+using speech_to_text_linux::LanguageRace;
+using speech_to_text_linux::PluginCore;
+using speech_to_text_linux::RaceCandidate;
+using speech_to_text_linux::ReadProcStatusKb;
+using speech_to_text_linux::RecognitionSession;
+using speech_to_text_linux::RecognizerLane;
+using speech_to_text_linux::RecognizerOptions;
+using speech_to_text_linux::SecondPass;
+using speech_to_text_linux::SpeechToTextLinuxPluginState;
+using speech_to_text_linux::TranscriptJournal;
+
+namespace {
+
+constexpr int kSkipped = 77;
+// Resident memory is sampled every ten minutes of audio; the first sample,
+// taken once the recognizer and buffers have warmed up, is the baseline.
+constexpr int64_t kSampleEverySeconds = 600;
+constexpr double kAllowedGrowth = 0.05;
+constexpr int64_t kAllowedGrowthFloorKb = 8 * 1024;
+// Chunks a lane may have queued before the next buffer is fed, so the
+// session's own recognizer does not outrun it and drop its audio.
+constexpr size_t kMaxLaneLag = 8;
+
+std::string Env(const char* name) {
+  const char* value = getenv(name);
+  return value != nullptr ? value : "";
+}
+
+// Reads the samples of a 16-bit mono PCM WAV file.
+bool ReadWav(const std::string& path, std::vector<int16_t>* samples, int* sample_rate) {
+  std::ifstream file(path, std::ios::binary);
+  char riff[12];
+  if (!file.read(riff, sizeof(riff)) || memcmp(riff, "RIFF", 4) != 0 ||
+      memcmp(riff + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+  bool format_ok = false;
+  char header[8];
+  while (file.read(header, sizeof(header))) {
+    uint32_t size = 0;
+    memcpy(&size, header + 4, 4);
+    if (memcmp(header, "fmt ", 4) == 0) {
+      std::vector<char> format(size);
+      if (size < 16 || !file.read(format.data(), size)) {
+        return false;
+      }
+      uint16_t tag = 0;
+      uint16_t channels = 0;
+      uint16_t bits = 0;
+      uint32_t rate = 0;
+      memcpy(&tag, format.data(), 2);
+      memcpy(&channels, format.data() + 2, 2);
+      memcpy(&rate, format.data() + 4, 4);
+      memcpy(&bits, format.data() + 14, 2);
+      format_ok = tag == 1 && channels == 1 && bits == 16;
+      *sample_rate = static_cast<int>(rate);
+    } else if (memcmp(header, "data", 4) == 0) {
+      samples->resize(size / 2);
+      return format_ok && file.read(reinterpret_cast<char*>(samples->data()), size / 2 * 2);
+    } else {
+      file.seekg(size + (size & 1), std::ios::cur);
+    }
+  }
+  return false;
+}
+
+GSourceFuncs no_dispatch_funcs = {};
+
+// Waits until the lanes and the second pass have room for another buffer.
+void WaitForBacklog(RecognitionSession* session) {
+  for (;;) {
+    bool behind = false;
+    for (const auto& lane : session->lanes) {
+      std::lock_guard<std::mutex> lock(lane->mutex);
+      behind = behind || lane->chunks.size() >= kMaxLaneLag;
+    }
+    if (session->second_pass != nullptr) {
+      std::lock_guard<std::mutex> lock(session->second_pass->mutex);
+      behind = behind || session->second_pass->audio_jobs >= session->second_pass->max_queue;
+    }
+    if (!behind) {
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// Waits until no lane or second-pass task is queued or running.
+void WaitForIdle(RecognitionSession* session) {
+  for (;;) {
+    bool busy = false;
+    for (const auto& lane : session->lanes) {
+      std::lock_guard<std::mutex> lock(lane->mutex);
+      busy = busy || !lane->chunks.empty() || lane->decode_scheduled.load();
+    }
+    if (session->second_pass != nullptr) {
+      std::lock_guard<std::mutex> lock(session->second_pass->mutex);
+      busy = busy || session->second_pass->scheduled;
+    }
+    if (!busy) {
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// Drains the events the platform thread would send; returns the finals.
+int64_t DrainEvents(EventQueue* events) {
+  int64_t finals = 0;
+  EventQueue::Event* event = nullptr;
+  while ((event = events->Pop()) != nullptr) {
+    if (event->typed != nullptr) {
+      fl_value_unref(event->typed);
+      event->typed = nullptr;
+    } else if (!event->is_double &&
+               event->payload.find("\"resultType\":2") != std::string::npos) {
+      finals++;
+    }
+  }
+  return finals;
+}
+
+}  // namespace
+
+int main() {
+  const std::string model_path = Env("SPEECH_TO_TEXT_SOAK_MODEL");
+  const std::string wav_path = Env("SPEECH_TO_TEXT_SOAK_WAV");
+  if (model_path.empty() || wav_path.empty()) {
+    printf("skipped: set SPEECH_TO_TEXT_SOAK_MODEL and SPEECH_TO_TEXT_SOAK_WAV\n");
+    return kSkipped;
+  }
+  const std::string seconds_arg = Env("SPEECH_TO_TEXT_SOAK_SECONDS");
+  const int64_t audio_seconds = seconds_arg.empty() ? 7200 : std::atoll(seconds_arg.c_str());
+
+  std::vector<int16_t> recording;
+  int sample_rate = 0;
+  if (!ReadWav(wav_path, &recording, &sample_rate) || recording.empty()) {
+    fprintf(stderr, "FAILED: %s is not a 16-bit mono WAV file\n", wav_path.c_str());
+    return EXIT_FAILURE;
+  }
+  const std::string mode = Env("SPEECH_TO_TEXT_SOAK_MODE");
+  if (!mode.empty() && mode != "continuous" && mode != "race" && mode != "second-pass") {
+    fprintf(stderr, "FAILED: unknown SPEECH_TO_TEXT_SOAK_MODE %s\n", mode.c_str());
+    return EXIT_FAILURE;
+  }
+
+  PluginCore core;
+  core.state = new SpeechToTextLinuxPluginState();
+  core.events = new EventQueue(kEventQueueSlots);
+  core.event_source = g_source_new(&no_dispatch_funcs, sizeof(GSource));
+  SpeechToTextLinuxPluginState* state = core.state;
+  if (!state->vosk.Load(Env("SPEECH_TO_TEXT_SOAK_VOSK"))) {
+    fprintf(stderr, "FAILED: %s\n", state->vosk.last_error().c_str());
+    return EXIT_FAILURE;
+  }
+  state->model = state->vosk.NewModel(model_path);
+  if (state->model == nullptr) {
+    fprintf(stderr, "FAILED: cannot open model %s\n", model_path.c_str());
+    return EXIT_FAILURE;
+  }
+  state->scheduler.reset(
+      new DecodeScheduler(std::max(std::thread::hardware_concurrency(), 2u)));
+  const std::string journal_path = std::string(g_get_tmp_dir()) + "/speech_to_text_soak_" +
+                                   std::to_string(getpid()) + ".jsonl";
+  state->journals[journal_path].reset(new TranscriptJournal(
+      journal_path, TranscriptJournal::SyncPolicy::kNever, std::chrono::milliseconds(1000)));
+
+  // Set up as `listen` would with `continuous`, `wordTimings` and a
+  // `transcriptJournalPath`, plus the mode's recognizers.
+  std::unique_ptr<RecognitionSession> session(
+      new RecognitionSession(1, &state->vosk, state->device_mutex));
+  session->continuous = true;
+  session->word_timings = true;
+  session->sample_rate = sample_rate;
+  session->journal = state->journals[journal_path].get();
+  session->decode_buffer.resize(std::max<size_t>(
+      session->frames_per_buffer, static_cast<size_t>(sample_rate) * kCatchUpBatchMillis / 1000));
+  session->ring.reset(new AudioRing(static_cast<size_t>(sample_rate) * 4));
+  session->endpointer.Configure(sample_rate, std::chrono::milliseconds(0), 12.0);
+  RecognizerOptions options;
+  options.sample_rate = static_cast<float>(sample_rate);
+  session->recognizer = CreateRecognizer(&state->vosk, state->model, options).recognizer;
+  if (mode == "race") {
+    std::unique_ptr<RecognizerLane> lane(new RecognizerLane());
+    lane->session = session.get();
+    lane->name = "lane";
+    lane->model = state->model;
+    lane->options = options;
+    lane->recognizer = CreateRecognizer(&state->vosk, state->model, options).recognizer;
+    lane->race_index = 1;
+    session->race.reset(new LanguageRace());
+    RaceCandidate own;
+    own.name = session->recognizer_name;
+    session->race->candidates.push_back(own);
+    RaceCandidate candidate;
+    candidate.name = lane->name;
+    session->race->candidates.push_back(candidate);
+    session->lanes.push_back(std::move(lane));
+    session->open_recognizers.store(2);
+  } else if (mode == "second-pass") {
+    std::unique_ptr<SecondPass> pass(new SecondPass());
+    pass->model = state->model;
+    pass->recognizer = state->vosk.NewRecognizer(state->model, options.sample_rate);
+    state->vosk.EnableWordTimings(pass->recognizer);
+    // Audio comes in faster than real time, so segments wait longer than
+    // a live session's would.
+    pass->budget = std::chrono::milliseconds(60000);
+    session->second_pass = std::move(pass);
+  }
+  if (session->recognizer == nullptr ||
+      (!session->lanes.empty() && session->lanes.front()->recognizer == nullptr) ||
+      (session->second_pass != nullptr && session->second_pass->recognizer == nullptr)) {
+    fprintf(stderr, "FAILED: cannot create a recognizer\n");
+    return EXIT_FAILURE;
+  }
+  session->stream_origin_ns.store(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+  session->ResetRecognitionTimers();
+  state->current_session_id.store(session->id);
+
+  const size_t chunk_frames = session->frames_per_buffer;
+  std::vector<int16_t> buffer(chunk_frames);
+  const int64_t total_samples = audio_seconds * sample_rate;
+  const int64_t sample_every = kSampleEverySeconds * sample_rate;
+  int64_t fed = 0;
+  int64_t finals = 0;
+  size_t position = 0;
+  int64_t baseline_kb = -1;
+  int64_t worst_kb = 0;
+  bool ended = false;
+  const auto started = std::chrono::steady_clock::now();
+  while (fed < total_samples) {
+    for (size_t i = 0; i < chunk_frames; ++i) {
+      buffer[i] = recording[position];
+      position = position + 1 < recording.size() ? position + 1 : 0;
+    }
+    WaitForBacklog(session.get());
+    // What the capture callback does with a device buffer.
+    session->ring->Write(buffer.data(), chunk_frames);
+    session->stream_captured += static_cast<int64_t>(chunk_frames);
+    ended = !DecodeSlice(&core, session.get());
+    finals += DrainEvents(core.events);
+    if (ended) {
+      break;
+    }
+    const int64_t before = fed;
+    fed += static_cast<int64_t>(chunk_frames);
+    if (fed / sample_every != before / sample_every) {
+      const int64_t rss_kb = ReadProcStatusKb("VmRSS");
+      const std::chrono::duration<double> wall = std::chrono::steady_clock::now() - started;
+      printf("%6lld s audio  %8.1f s wall  %6lld segments  %8lld kB resident\n",
+             static_cast<long long>(fed / sample_rate), wall.count(),
+             static_cast<long long>(session->segments), static_cast<long long>(rss_kb));
+      fflush(stdout);
+      if (baseline_kb < 0) {
+        baseline_kb = rss_kb;
+      }
+      worst_kb = std::max(worst_kb, rss_kb);
+    }
+  }
+  WaitForIdle(session.get());
+  finals += DrainEvents(core.events);
+  const int64_t segments = session->segments;
+  state->scheduler.reset();
+  for (const auto& lane : session->lanes) {
+    state->vosk.FreeRecognizer(lane->recognizer);
+    lane->recognizer = nullptr;
+  }
+  session.reset();
+  state->journals.clear();
+  unlink(journal_path.c_str());
+
+  if (ended) {
+    fprintf(stderr, "FAILED: the session ended after %lld s of audio\n",
+            static_cast<long long>(fed / sample_rate));
+    return EXIT_FAILURE;
+  }
+  if (segments == 0 || finals == 0) {
+    fprintf(stderr, "FAILED: no segment final in %lld s of audio; is there speech in %s?\n",
+            static_cast<long long>(audio_seconds), wav_path.c_str());
+    return EXIT_FAILURE;
+  }
+  if (baseline_kb < 0) {
+    printf("ok, but too short to sample memory; use at least %lld s\n",
+           static_cast<long long>(2 * kSampleEverySeconds));
+    return EXIT_SUCCESS;
+  }
+  const int64_t allowed_kb = std::max(static_cast<int64_t>(baseline_kb * kAllowedGrowth),
+                                      kAllowedGrowthFloorKb);
+  if (worst_kb - baseline_kb > allowed_kb) {
+    fprintf(stderr, "FAILED: resident memory grew from %lld kB to %lld kB\n",
+            static_cast<long long>(baseline_kb), static_cast<long long>(worst_kb));
+    return EXIT_FAILURE;
+  }
+  printf("ok: %lld segments, resident memory %lld kB to %lld kB\n",
+         static_cast<long long>(segments), static_cast<long long>(baseline_kb),
+         static_cast<long long>(worst_kb));
+  return EXIT_SUCCESS;
+}
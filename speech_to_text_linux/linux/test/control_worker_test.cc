@@ -0,0 +1,206 @@
+// Checks how the control worker orders method calls: cheap calls run at
+// once when nothing blocks them, wait only until an earlier blocking call
+// settles rather than until it returns, and are answered by |drop| when the
+// worker goes away first. Shutting down, as dispose does on the platform
+// thread, must not wait for a call in progress.
+//
+// Built with -DSPEECH_TO_TEXT_LINUX_TESTS=ON and run by ctest.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "../control_worker.h"
+
+using speech_to_text_linux::ControlWorker;
+
+namespace {
+
+constexpr auto kPatience = std::chrono::seconds(5);
+
+// A one-shot flag to wait for across threads.
+class Signal {
+ public:
+  void Raise() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      raised_ = true;
+    }
+    cv_.notify_all();
+  }
+  bool Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, kPatience, [this]() { return raised_; });
+  }
+  bool raised() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return raised_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool raised_ = false;
+};
+
+ControlWorker::Job MakeJob(std::function<void()> run, std::function<void()> drop = [] {}) {
+  ControlWorker::Job job;
+  job.run = std::move(run);
+  job.drop = std::move(drop);
+  return job;
+}
+
+bool Fail(const char* test, const char* what) {
+  fprintf(stderr, "FAILED %s: %s\n", test, what);
+  return false;
+}
+
+bool TestCheapRunsInline() {
+  const std::thread::id caller = std::this_thread::get_id();
+  bool inline_run = false;
+  ControlWorker worker;
+  worker.PostCheap(MakeJob([&] { inline_run = std::this_thread::get_id() == caller; }));
+  if (!inline_run) {
+    return Fail("cheap runs inline", "an idle worker queued the call");
+  }
+  printf("ok cheap runs inline\n");
+  return true;
+}
+
+// `stop` right after `listen`: it must see the registered session, but not
+// wait for the device to open.
+bool TestCheapWaitsForSettle() {
+  Signal registered;
+  Signal opened;
+  Signal stopped;
+  bool saw_session = false;
+  // Declared last, so its threads are gone before what the jobs use.
+  ControlWorker worker;
+  worker.PostBlocking(MakeJob([&] {
+    registered.Raise();
+    worker.Settle();
+    opened.Wait();
+  }));
+  worker.PostCheap(MakeJob([&] {
+    saw_session = registered.raised();
+    stopped.Raise();
+  }));
+  const bool stopped_during_open = stopped.Wait();
+  opened.Raise();
+  if (!stopped_during_open) {
+    return Fail("cheap waits for settle", "the cheap call waited for the whole blocking call");
+  }
+  if (!saw_session) {
+    return Fail("cheap waits for settle", "the cheap call overtook the blocking call");
+  }
+  printf("ok cheap waits for settle\n");
+  return true;
+}
+
+// A blocking call after a queued cheap one must not overtake it.
+bool TestBlockingWaitsForCheap() {
+  Signal release;
+  Signal done;
+  std::mutex order_mutex;
+  std::vector<int> order;
+  auto record = [&](int step) {
+    std::lock_guard<std::mutex> lock(order_mutex);
+    order.push_back(step);
+  };
+  ControlWorker worker;
+  worker.PostBlocking(MakeJob([&] {
+    release.Wait();
+    record(1);
+  }));
+  worker.PostCheap(MakeJob([&] { record(2); }));
+  worker.PostBlocking(MakeJob([&] {
+    record(3);
+    done.Raise();
+  }));
+  release.Raise();
+  if (!done.Wait()) {
+    return Fail("blocking waits for cheap", "the calls never ran");
+  }
+  std::lock_guard<std::mutex> lock(order_mutex);
+  if (order != std::vector<int>({1, 2, 3})) {
+    return Fail("blocking waits for cheap", "calls ran out of order");
+  }
+  printf("ok blocking waits for cheap\n");
+  return true;
+}
+
+bool TestQueuedCallsDropped() {
+  int dropped = 0;
+  int ran = 0;
+  Signal running;
+  Signal release;
+  std::thread releaser;
+  {
+    ControlWorker worker;
+    worker.PostBlocking(MakeJob([&] {
+      running.Raise();
+      release.Wait();
+      ran++;
+    }));
+    worker.PostBlocking(MakeJob([&] { ran++; }, [&] { dropped++; }));
+    worker.PostCheap(MakeJob([&] { ran++; }, [&] { dropped++; }));
+    running.Wait();
+    // Lets the running call finish only once the worker is shutting down.
+    releaser = std::thread([&] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      release.Raise();
+    });
+  }
+  releaser.join();
+  if (ran != 1 || dropped != 2) {
+    return Fail("queued calls dropped", "queued calls ran or went unanswered");
+  }
+  printf("ok queued calls dropped\n");
+  return true;
+}
+
+// A `listen` still opening its device must not hold up dispose.
+bool TestShutdownDoesNotWait() {
+  Signal running;
+  Signal release;
+  int dropped = 0;
+  bool shut_down_while_running = false;
+  {
+    ControlWorker worker;
+    worker.PostBlocking(MakeJob([&] {
+      running.Raise();
+      release.Wait();
+    }));
+    worker.PostBlocking(MakeJob([] {}, [&] { dropped++; }));
+    running.Wait();
+    worker.Shutdown();
+    shut_down_while_running = !release.raised();
+    // Calls that come in later are answered at once.
+    worker.PostCheap(MakeJob([] {}, [&] { dropped++; }));
+    release.Raise();
+  }
+  if (!shut_down_while_running) {
+    return Fail("shutdown does not wait", "shutdown waited for the running call");
+  }
+  if (dropped != 2) {
+    return Fail("shutdown does not wait", "queued or late calls went unanswered");
+  }
+  printf("ok shutdown does not wait\n");
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  bool passed = true;
+  passed &= TestCheapRunsInline();
+  passed &= TestCheapWaitsForSettle();
+  passed &= TestBlockingWaitsForCheap();
+  passed &= TestQueuedCallsDropped();
+  passed &= TestShutdownDoesNotWait();
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,135 @@
+// Races `stop`/`cancel` against the session lifecycle, for ThreadSanitizer:
+// the target is built with -fsanitize=thread. Besides data races it checks
+// that exactly one stop wins, that a stop that lost to the session ending
+// on its own leaves no cancel behind, and that a stop during `listen`'s
+// open is not overwritten when the stream starts.
+//
+// Built with -DSPEECH_TO_TEXT_LINUX_TESTS=ON and run by ctest.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../recognition_session.h"
+
+using speech_to_text_linux::RecognitionSession;
+using speech_to_text_linux::SessionPhase;
+using speech_to_text_linux::VoskApi;
+
+namespace {
+
+constexpr int kRounds = 2000;
+constexpr int kStoppers = 3;
+
+// Releases every thread of a round at once, to widen the race windows.
+// The threads poll rather than block on a mutex, which would order them for
+// ThreadSanitizer and hide the races under test.
+class StartLine {
+ public:
+  void Wait() const {
+    while (!open_.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+  void Open() { open_.store(true, std::memory_order_release); }
+
+ private:
+  std::atomic<bool> open_{false};
+};
+
+// Stops racing the decode task's move to kFinalizing, as when `stop` comes
+// in just as the session ends on an endpoint.
+bool TestStopAgainstFinalize(const VoskApi* vosk) {
+  auto device_mutex = std::make_shared<std::mutex>();
+  for (int round = 0; round < kRounds; ++round) {
+    RecognitionSession session(round + 1, vosk, device_mutex);
+    session.phase.store(SessionPhase::kListening);
+    StartLine start;
+    std::atomic<int> wins{0};
+    std::vector<std::thread> stoppers;
+    for (int i = 0; i < kStoppers; ++i) {
+      stoppers.emplace_back([&session, &start, &wins, i] {
+        start.Wait();
+        if (session.RequestStop(i == 0, true, std::chrono::steady_clock::now())) {
+          wins.fetch_add(1);
+        }
+      });
+    }
+    bool stopped = false;
+    bool from_user = false;
+    std::thread finisher([&] {
+      start.Wait();
+      stopped = session.BeginFinalizing();
+      if (stopped) {
+        from_user = session.stop_from_user;
+      }
+    });
+    start.Open();
+    for (auto& stopper : stoppers) {
+      stopper.join();
+    }
+    finisher.join();
+    if (wins.load() != (stopped ? 1 : 0)) {
+      fprintf(stderr, "FAILED stop against finalize: %d stops won, stopped %d\n", wins.load(),
+              stopped);
+      return false;
+    }
+    if (stopped && !from_user) {
+      fprintf(stderr, "FAILED stop against finalize: stop details not published\n");
+      return false;
+    }
+    if (!stopped && session.cancel_requested.load()) {
+      fprintf(stderr, "FAILED stop against finalize: a losing cancel was recorded\n");
+      return false;
+    }
+  }
+  printf("ok stop against finalize\n");
+  return true;
+}
+
+// A stop while `listen` is still opening the device, racing its move from
+// kStarting to kListening.
+bool TestStopDuringStart(const VoskApi* vosk) {
+  auto device_mutex = std::make_shared<std::mutex>();
+  for (int round = 0; round < kRounds; ++round) {
+    RecognitionSession session(round + 1, vosk, device_mutex);
+    session.phase.store(SessionPhase::kStarting);
+    StartLine start;
+    bool stop_won = false;
+    std::thread stopper([&] {
+      start.Wait();
+      stop_won = session.RequestStop(true, true, std::chrono::steady_clock::now());
+    });
+    std::thread listener([&] {
+      start.Wait();
+      session.MarkListening();
+    });
+    start.Open();
+    stopper.join();
+    listener.join();
+    // Listening sessions accept stops, so the stop always wins here; it
+    // must still be visible once the stream runs.
+    if (!stop_won || session.phase.load() != SessionPhase::kStopping) {
+      fprintf(stderr, "FAILED stop during start: stop lost\n");
+      return false;
+    }
+  }
+  printf("ok stop during start\n");
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  // No library loaded: sessions here never build a recognizer.
+  VoskApi vosk;
+  bool passed = true;
+  passed &= TestStopAgainstFinalize(&vosk);
+  passed &= TestStopDuringStart(&vosk);
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
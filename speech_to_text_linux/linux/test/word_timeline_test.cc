@@ -0,0 +1,160 @@
+// Checks that word times move onto the session's timeline: Vosk counts
+// every sample a recognizer was fed since it was created, across Reset and
+// pooled reuse, and never sees audio that was skipped, so RecognizerClock
+// has to map its times back onto stream positions. Also checks the word
+// confidence of N-best results, and that stream positions count audio a
+// full capture ring dropped.
+//
+// Built with -DSPEECH_TO_TEXT_LINUX_TESTS=ON and run by ctest.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../decode_pipeline.h"
+
+using speech_to_text_linux::AudioRing;
+using speech_to_text_linux::ExtractSessionWords;
+using speech_to_text_linux::RecognitionSession;
+using speech_to_text_linux::RecognizerClock;
+using speech_to_text_linux::WordTiming;
+
+namespace {
+
+constexpr int kRate = 16000;
+
+bool ExpectNear(const char* test, double actual, double expected) {
+  if (std::fabs(actual - expected) > 1e-6) {
+    fprintf(stderr, "FAILED %s: got %.6f, expected %.6f\n", test, actual, expected);
+    return false;
+  }
+  return true;
+}
+
+// Two segments of one continuous session, with the recognizer reset in
+// between: its clock runs on, and so does the stream.
+bool TestAcrossReset() {
+  RecognizerClock clock;
+  clock.Feed(0, 2 * kRate);
+  clock.Feed(2 * kRate, 3 * kRate);
+  // 4.5 s into the recognizer's audio is 4.5 s into the stream.
+  bool ok = ExpectNear("across reset", clock.ToStream(4.5, kRate) / kRate, 4.5);
+  if (ok) {
+    printf("ok across reset\n");
+  }
+  return ok;
+}
+
+// A pooled recognizer starts a new session with a minute already fed.
+bool TestPooledReuse() {
+  RecognizerClock clock;
+  clock.fed = 60 * kRate;
+  clock.Feed(0, 2 * kRate);
+  bool ok = ExpectNear("pooled reuse", clock.ToStream(61.25, kRate) / kRate, 1.25);
+  if (ok) {
+    printf("ok pooled reuse\n");
+  }
+  return ok;
+}
+
+// Catching up skipped a second of silence mid-utterance: words after it
+// are a second later in the stream than on the recognizer's clock.
+bool TestCatchUpSkip() {
+  RecognizerClock clock;
+  clock.Feed(0, kRate);
+  clock.Feed(2 * kRate, kRate);
+  bool ok = ExpectNear("catch-up skip before", clock.ToStream(0.5, kRate) / kRate, 0.5);
+  ok &= ExpectNear("catch-up skip after", clock.ToStream(1.5, kRate) / kRate, 2.5);
+  if (ok) {
+    printf("ok catch-up skip\n");
+  }
+  return ok;
+}
+
+// The second pass only hears the segments, so its clock skips the gaps.
+bool TestSecondPassSegments() {
+  RecognizerClock clock;
+  clock.Feed(3 * kRate, kRate);
+  clock.Feed(10 * kRate, 2 * kRate);
+  RecognitionSession session(1, nullptr, std::make_shared<std::mutex>());
+  session.sample_rate = kRate;
+  std::vector<WordTiming> words;
+  const char* json =
+      "{\"result\":[{\"conf\":1.0,\"end\":1.6,\"start\":1.2,\"word\":\"again\"}],"
+      "\"text\":\"again\"}";
+  bool ok = ExtractSessionWords(&session, clock, json, -1.0, &words) && words.size() == 1;
+  if (!ok) {
+    fprintf(stderr, "FAILED second pass segments: no words\n");
+    return false;
+  }
+  ok &= ExpectNear("second pass start", words[0].start, 10.2);
+  ok &= ExpectNear("second pass end", words[0].end, 10.6);
+  if (ok) {
+    printf("ok second pass segments\n");
+  }
+  return ok;
+}
+
+// N-best results give no per-word confidence; the words take the top
+// hypothesis's normalized confidence the result was sent with.
+bool TestNBestConfidence() {
+  RecognizerClock clock;
+  clock.Feed(0, 2 * kRate);
+  RecognitionSession session(1, nullptr, std::make_shared<std::mutex>());
+  session.sample_rate = kRate;
+  const char* json =
+      "{\"alternatives\":[{\"confidence\":312.5,\"result\":[{\"end\":0.9,\"start\":0.6,"
+      "\"word\":\"stop\"}],\"text\":\"stop\"},{\"confidence\":290.1,\"result\":[],"
+      "\"text\":\"\"}]}";
+  std::vector<WordTiming> words;
+  if (!ExtractSessionWords(&session, clock, json, 0.8, &words) || words.size() != 1) {
+    fprintf(stderr, "FAILED n-best confidence: no words\n");
+    return false;
+  }
+  const bool ok = ExpectNear("n-best confidence", words[0].conf, 0.8);
+  if (ok) {
+    printf("ok n-best confidence\n");
+  }
+  return ok;
+}
+
+// The decode side falls behind and the ring drops the end of a buffer:
+// reads stop at the gap and report it, so stream positions keep counting
+// every sample the device delivered.
+bool TestRingGap() {
+  AudioRing ring(128);
+  std::vector<int16_t> buffer(200);
+  std::vector<int16_t> out(200);
+  ring.Write(buffer.data(), 100);
+  const size_t stored = ring.Write(buffer.data(), 100);
+  uint64_t skipped = 0;
+  const size_t before = ring.Read(out.data(), 64, &skipped);
+  ring.Write(buffer.data(), 50);
+  const size_t up_to_gap = ring.Read(out.data(), out.size(), &skipped);
+  const uint64_t skipped_before_gap = skipped;
+  const size_t after_gap = ring.Read(out.data(), out.size(), &skipped);
+  if (stored != 28 || before != 64 || up_to_gap != 64 || skipped_before_gap != 0 ||
+      after_gap != 50 || skipped != 72 || ring.dropped_samples() != 72) {
+    fprintf(stderr, "FAILED ring gap: read %zu, %zu then %zu after skipping %llu\n", before,
+            up_to_gap, after_gap, static_cast<unsigned long long>(skipped));
+    return false;
+  }
+  printf("ok ring gap\n");
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  bool passed = true;
+  passed &= TestAcrossReset();
+  passed &= TestPooledReuse();
+  passed &= TestCatchUpSkip();
+  passed &= TestSecondPassSegments();
+  passed &= TestNBestConfidence();
+  passed &= TestRingGap();
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,270 @@
+#include "vosk_api.h"
+
+#include <dlfcn.h>
+
+#include <vector>
+
+namespace speech_to_text_linux {
+
+// Searched on the library path when no `voskLibraryPath` is given.
+constexpr const char* kVoskLibraryNames[] = {"libvosk.so", "libvosk.so.1"};
+
+void* PreloadVoskLibrary() {
+  for (const char* name : kVoskLibraryNames) {
+    void* handle = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+    if (handle != nullptr) {
+      return handle;
+    }
+  }
+  return nullptr;
+}
+
+bool VoskApi::Load(const std::string& custom_path) {
+  if (Ready()) {
+    return true;
+  }
+  std::vector<std::string> candidates;
+  if (!custom_path.empty()) {
+    candidates.push_back(custom_path);
+  }
+  for (const char* name : kVoskLibraryNames) {
+    candidates.emplace_back(name);
+  }
+
+  // RTLD_NOW: resolve every symbol here rather than on the first
+  // AcceptWaveform.
+  for (const auto& candidate : candidates) {
+    handle_ = dlopen(candidate.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle_ != nullptr) {
+      break;
+    }
+  }
+
+  if (handle_ == nullptr) {
+    const char* error = dlerror();
+    last_error_ = error != nullptr ? error : "Unable to load libvosk";
+    return false;
+  }
+
+#define LOAD_VOSK_SYMBOL(field, symbol)                                              \
+  field = reinterpret_cast<decltype(field)>(dlsym(handle_, symbol));                \
+  if (field == nullptr) {                                                            \
+    last_error_ = std::string("Missing symbol from libvosk: ") + symbol;          \
+    Unload();                                                                        \
+    return false;                                                                    \
+  }
+
+  LOAD_VOSK_SYMBOL(functions_.model_new, "vosk_model_new");
+  LOAD_VOSK_SYMBOL(functions_.model_free, "vosk_model_free");
+  LOAD_VOSK_SYMBOL(functions_.recognizer_new, "vosk_recognizer_new");
+  LOAD_VOSK_SYMBOL(functions_.recognizer_free, "vosk_recognizer_free");
+  LOAD_VOSK_SYMBOL(functions_.recognizer_accept, "vosk_recognizer_accept_waveform");
+  LOAD_VOSK_SYMBOL(functions_.recognizer_result, "vosk_recognizer_result");
+  LOAD_VOSK_SYMBOL(functions_.recognizer_partial, "vosk_recognizer_partial_result");
+  LOAD_VOSK_SYMBOL(functions_.recognizer_final, "vosk_recognizer_final_result");
+  LOAD_VOSK_SYMBOL(functions_.recognizer_reset, "vosk_recognizer_reset");
+  LOAD_VOSK_SYMBOL(functions_.recognizer_set_words, "vosk_recognizer_set_words");
+  LOAD_VOSK_SYMBOL(functions_.recognizer_set_partial_words, "vosk_recognizer_set_partial_words");
+  LOAD_VOSK_SYMBOL(functions_.set_log_level, "vosk_set_log_level");
+
+#undef LOAD_VOSK_SYMBOL
+
+#define LOAD_OPTIONAL_VOSK_SYMBOL(field, symbol) \
+  field = reinterpret_cast<decltype(field)>(dlsym(handle_, symbol));
+
+  LOAD_OPTIONAL_VOSK_SYMBOL(functions_.recognizer_set_endpointer_mode,
+                            "vosk_recognizer_set_endpointer_mode");
+  LOAD_OPTIONAL_VOSK_SYMBOL(functions_.recognizer_set_endpointer_delays,
+                            "vosk_recognizer_set_endpointer_delays");
+  LOAD_OPTIONAL_VOSK_SYMBOL(functions_.recognizer_new_grm, "vosk_recognizer_new_grm");
+  LOAD_OPTIONAL_VOSK_SYMBOL(functions_.recognizer_set_grm, "vosk_recognizer_set_grm");
+  LOAD_OPTIONAL_VOSK_SYMBOL(functions_.recognizer_set_max_alternatives,
+                            "vosk_recognizer_set_max_alternatives");
+
+#undef LOAD_OPTIONAL_VOSK_SYMBOL
+
+  last_error_.clear();
+  return true;
+}
+
+bool VoskApi::Bind(const Functions& functions) {
+  Unload();
+  if (functions.model_new == nullptr || functions.model_free == nullptr ||
+      functions.recognizer_new == nullptr || functions.recognizer_free == nullptr ||
+      functions.recognizer_accept == nullptr || functions.recognizer_result == nullptr ||
+      functions.recognizer_partial == nullptr || functions.recognizer_final == nullptr ||
+      functions.recognizer_reset == nullptr) {
+    last_error_ = "Missing Vosk entry point";
+    return false;
+  }
+  functions_ = functions;
+  bound_ = true;
+  last_error_.clear();
+  return true;
+}
+
+void VoskApi::Unload() {
+  if (handle_ != nullptr) {
+    dlclose(handle_);
+    handle_ = nullptr;
+  }
+  bound_ = false;
+  functions_ = Functions();
+}
+
+VoskModel* VoskApi::NewModel(const std::string& path) const {
+  if (!Ready()) {
+    return nullptr;
+  }
+  return functions_.model_new != nullptr ? functions_.model_new(path.c_str()) : nullptr;
+}
+
+void VoskApi::FreeModel(VoskModel* model) const {
+  if (model != nullptr && functions_.model_free != nullptr) {
+    functions_.model_free(model);
+  }
+}
+
+VoskRecognizer* VoskApi::NewRecognizer(VoskModel* model, float sample_rate) const {
+  if (!Ready() || model == nullptr || functions_.recognizer_new == nullptr) {
+    return nullptr;
+  }
+  return functions_.recognizer_new(model, sample_rate);
+}
+
+void VoskApi::FreeRecognizer(VoskRecognizer* recognizer) const {
+  if (recognizer != nullptr && functions_.recognizer_free != nullptr) {
+    functions_.recognizer_free(recognizer);
+  }
+}
+
+int VoskApi::AcceptWaveform(VoskRecognizer* recognizer, const int16_t* data, int frames) const {
+  if (recognizer == nullptr || functions_.recognizer_accept == nullptr || data == nullptr ||
+      frames <= 0) {
+    return 0;
+  }
+  const int bytes = static_cast<int>(frames * sizeof(int16_t));
+  return functions_.recognizer_accept(recognizer, reinterpret_cast<const char*>(data), bytes);
+}
+
+std::string VoskApi::Result(VoskRecognizer* recognizer) const {
+  if (recognizer == nullptr || functions_.recognizer_result == nullptr) {
+    return {};
+  }
+  const char* value = functions_.recognizer_result(recognizer);
+  return value != nullptr ? std::string(value) : std::string();
+}
+
+const char* VoskApi::PartialResult(VoskRecognizer* recognizer) const {
+  if (recognizer == nullptr || functions_.recognizer_partial == nullptr) {
+    return "";
+  }
+  const char* value = functions_.recognizer_partial(recognizer);
+  return value != nullptr ? value : "";
+}
+
+std::string VoskApi::FinalResult(VoskRecognizer* recognizer) const {
+  if (recognizer == nullptr || functions_.recognizer_final == nullptr) {
+    return {};
+  }
+  const char* value = functions_.recognizer_final(recognizer);
+  return value != nullptr ? std::string(value) : std::string();
+}
+
+void VoskApi::Reset(VoskRecognizer* recognizer) const {
+  if (recognizer != nullptr && functions_.recognizer_reset != nullptr) {
+    functions_.recognizer_reset(recognizer);
+  }
+}
+
+void VoskApi::EnableWordTimings(VoskRecognizer* recognizer) const {
+  if (recognizer != nullptr && functions_.recognizer_set_words != nullptr) {
+    functions_.recognizer_set_words(recognizer, 1);
+  }
+}
+
+void VoskApi::EnablePartialWords(VoskRecognizer* recognizer, bool enabled) const {
+  if (recognizer != nullptr && functions_.recognizer_set_partial_words != nullptr) {
+    functions_.recognizer_set_partial_words(recognizer, enabled ? 1 : 0);
+  }
+}
+
+bool VoskApi::SetMaxAlternatives(VoskRecognizer* recognizer, int count) const {
+  if (recognizer == nullptr || functions_.recognizer_set_max_alternatives == nullptr) {
+    return false;
+  }
+  functions_.recognizer_set_max_alternatives(recognizer, count);
+  return true;
+}
+
+VoskRecognizer* VoskApi::NewGrammarRecognizer(VoskModel* model, float sample_rate,
+                                              const std::string& grammar) const {
+  if (!Ready() || model == nullptr || functions_.recognizer_new_grm == nullptr) {
+    return nullptr;
+  }
+  return functions_.recognizer_new_grm(model, sample_rate, grammar.c_str());
+}
+
+bool VoskApi::SetGrammar(VoskRecognizer* recognizer, const std::string& grammar) const {
+  if (recognizer == nullptr || functions_.recognizer_set_grm == nullptr) {
+    return false;
+  }
+  functions_.recognizer_set_grm(recognizer, grammar.c_str());
+  return true;
+}
+
+bool VoskApi::SetEndpointerMode(VoskRecognizer* recognizer, int mode) const {
+  if (recognizer == nullptr || functions_.recognizer_set_endpointer_mode == nullptr) {
+    return false;
+  }
+  functions_.recognizer_set_endpointer_mode(recognizer, mode);
+  return true;
+}
+
+bool VoskApi::SetEndpointerDelays(VoskRecognizer* recognizer, float start_max_seconds,
+                                  float end_seconds, float max_seconds) const {
+  if (recognizer == nullptr || functions_.recognizer_set_endpointer_delays == nullptr) {
+    return false;
+  }
+  functions_.recognizer_set_endpointer_delays(recognizer, start_max_seconds, end_seconds,
+                                              max_seconds);
+  return true;
+}
+
+void VoskApi::ConfigureLogging(bool debug) const {
+  if (functions_.set_log_level != nullptr) {
+    functions_.set_log_level(debug ? 0 : -1);
+  }
+}
+
+RecognizerSetup CreateRecognizer(const VoskApi* vosk, VoskModel* model,
+                                 const RecognizerOptions& options) {
+  RecognizerSetup setup;
+  setup.recognizer = options.grammar.empty()
+                         ? vosk->NewRecognizer(model, options.sample_rate)
+                         : vosk->NewGrammarRecognizer(model, options.sample_rate, options.grammar);
+  if (setup.recognizer == nullptr) {
+    return setup;
+  }
+  vosk->EnableWordTimings(setup.recognizer);
+  vosk->EnablePartialWords(setup.recognizer, options.partial_words);
+  if (options.max_alternatives > 0) {
+    vosk->SetMaxAlternatives(setup.recognizer, options.max_alternatives);
+  }
+  if (options.wants_vosk_endpointer()) {
+    bool applied = options.vosk_endpointer_mode < 0 ||
+                   vosk->SetEndpointerMode(setup.recognizer, options.vosk_endpointer_mode);
+    if (options.vosk_endpointer_end_ms > 0) {
+      applied = vosk->SetEndpointerDelays(
+                    setup.recognizer,
+                    static_cast<float>(options.vosk_endpointer_start_max_ms) / 1000.0f,
+                    static_cast<float>(options.vosk_endpointer_end_ms) / 1000.0f,
+                    static_cast<float>(options.vosk_endpointer_max_ms) / 1000.0f) &&
+                applied;
+    }
+    setup.vosk_endpointer = applied;
+  }
+  return setup;
+}
+
+}  // namespace speech_to_text_linux
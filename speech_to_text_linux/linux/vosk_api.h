@@ -0,0 +1,131 @@
+#ifndef SPEECH_TO_TEXT_LINUX_VOSK_API_H_
+#define SPEECH_TO_TEXT_LINUX_VOSK_API_H_
+
+#include <cstdint>
+#include <string>
+
+namespace speech_to_text_linux {
+
+struct VoskModel;
+struct VoskRecognizer;
+
+// Everything needed to build a session recognizer away from the GTK thread.
+struct RecognizerOptions {
+  float sample_rate = 16000.0f;
+  bool partial_words = true;
+  int vosk_endpointer_mode = -1;
+  int vosk_endpointer_start_max_ms = 5000;
+  int vosk_endpointer_end_ms = 0;
+  int vosk_endpointer_max_ms = 20000;
+  // JSON array of phrases; empty for free dictation.
+  std::string grammar;
+  // N-best list size; 0 keeps the plain single-result output.
+  int max_alternatives = 0;
+
+  bool wants_vosk_endpointer() const {
+    return vosk_endpointer_mode >= 0 || vosk_endpointer_end_ms > 0;
+  }
+};
+
+struct RecognizerSetup {
+  VoskRecognizer* recognizer = nullptr;
+  bool vosk_endpointer = false;
+  // Samples a pooled recognizer was fed in earlier sessions.
+  int64_t fed_samples = 0;
+};
+
+class VoskApi {
+ public:
+  // libvosk's entry points. The optional ones stay null when the loaded
+  // build lacks them.
+  struct Functions {
+    using ModelNewFn = VoskModel* (*)(const char*);
+    using ModelFreeFn = void (*)(VoskModel*);
+    using RecognizerNewFn = VoskRecognizer* (*)(VoskModel*, float);
+    using RecognizerNewGrmFn = VoskRecognizer* (*)(VoskModel*, float, const char*);
+    using RecognizerSetGrmFn = void (*)(VoskRecognizer*, const char*);
+    using RecognizerFreeFn = void (*)(VoskRecognizer*);
+    using RecognizerAcceptFn = int (*)(VoskRecognizer*, const char*, int);
+    using RecognizerResultFn = const char* (*)(VoskRecognizer*);
+    using RecognizerResetFn = void (*)(VoskRecognizer*);
+    using RecognizerSetIntFn = void (*)(VoskRecognizer*, int);
+    using RecognizerSetDelaysFn = void (*)(VoskRecognizer*, float, float, float);
+    using SetLogLevelFn = void (*)(int);
+
+    ModelNewFn model_new = nullptr;
+    ModelFreeFn model_free = nullptr;
+    RecognizerNewFn recognizer_new = nullptr;
+    RecognizerFreeFn recognizer_free = nullptr;
+    RecognizerAcceptFn recognizer_accept = nullptr;
+    RecognizerResultFn recognizer_result = nullptr;
+    RecognizerResultFn recognizer_partial = nullptr;
+    RecognizerResultFn recognizer_final = nullptr;
+    RecognizerResetFn recognizer_reset = nullptr;
+    RecognizerSetIntFn recognizer_set_words = nullptr;
+    RecognizerSetIntFn recognizer_set_partial_words = nullptr;
+    // Optional: only present in libvosk builds that ship the endpointer API.
+    RecognizerSetIntFn recognizer_set_endpointer_mode = nullptr;
+    RecognizerSetDelaysFn recognizer_set_endpointer_delays = nullptr;
+    // Optional: grammar recognizers, and updating a recognizer's grammar.
+    RecognizerNewGrmFn recognizer_new_grm = nullptr;
+    RecognizerSetGrmFn recognizer_set_grm = nullptr;
+    // Optional: N-best results.
+    RecognizerSetIntFn recognizer_set_max_alternatives = nullptr;
+    SetLogLevelFn set_log_level = nullptr;
+  };
+
+  bool Load(const std::string& custom_path);
+  // Uses |functions| instead of loading libvosk, e.g. a test's stubs.
+  // Fails when a required entry point is missing.
+  bool Bind(const Functions& functions);
+  void Unload();
+  bool Ready() const { return handle_ != nullptr || bound_; }
+  std::string last_error() const { return last_error_; }
+
+  VoskModel* NewModel(const std::string& path) const;
+  void FreeModel(VoskModel* model) const;
+
+  VoskRecognizer* NewRecognizer(VoskModel* model, float sample_rate) const;
+  VoskRecognizer* NewGrammarRecognizer(VoskModel* model, float sample_rate,
+                                       const std::string& grammar) const;
+  bool SetGrammar(VoskRecognizer* recognizer, const std::string& grammar) const;
+  bool SupportsGrammar() const { return functions_.recognizer_new_grm != nullptr; }
+  bool SupportsGrammarUpdate() const { return functions_.recognizer_set_grm != nullptr; }
+  void FreeRecognizer(VoskRecognizer* recognizer) const;
+  int AcceptWaveform(VoskRecognizer* recognizer, const int16_t* data, int frames) const;
+  std::string Result(VoskRecognizer* recognizer) const;
+  // Polled for every chunk, so it hands out libvosk's buffer, valid until
+  // the next call on |recognizer|, instead of a copy.
+  const char* PartialResult(VoskRecognizer* recognizer) const;
+  std::string FinalResult(VoskRecognizer* recognizer) const;
+  void Reset(VoskRecognizer* recognizer) const;
+  void EnableWordTimings(VoskRecognizer* recognizer) const;
+  void EnablePartialWords(VoskRecognizer* recognizer, bool enabled) const;
+  bool SetMaxAlternatives(VoskRecognizer* recognizer, int count) const;
+  bool SupportsAlternatives() const {
+    return functions_.recognizer_set_max_alternatives != nullptr;
+  }
+  bool SetEndpointerMode(VoskRecognizer* recognizer, int mode) const;
+  bool SetEndpointerDelays(VoskRecognizer* recognizer, float start_max_seconds,
+                           float end_seconds, float max_seconds) const;
+  void ConfigureLogging(bool debug) const;
+
+ private:
+  void* handle_ = nullptr;
+  // Set by Bind, which has no library handle.
+  bool bound_ = false;
+  Functions functions_;
+  mutable std::string last_error_;
+};
+
+// Loads libvosk and its dependencies (Kaldi, BLAS) with every relocation
+// done. Run at registration so `initialize` finds the library mapped;
+// returns the handle, or null when it is not on the library path.
+void* PreloadVoskLibrary();
+
+RecognizerSetup CreateRecognizer(const VoskApi* vosk, VoskModel* model,
+                                 const RecognizerOptions& options);
+
+}  // namespace speech_to_text_linux
+
+#endif  // SPEECH_TO_TEXT_LINUX_VOSK_API_H_
@@ -1,10 +1,46 @@
+import 'dart:typed_data';
+
+import 'package:flutter/services.dart';
 import 'package:flutter_test/flutter_test.dart';
 import 'package:speech_to_text_linux/speech_to_text_linux.dart';
 import 'package:speech_to_text_platform_interface/speech_to_text_platform_interface.dart';
 
+const MethodChannel channel = MethodChannel('speech_to_text_linux');
+
+TestDefaultBinaryMessenger get messenger =>
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger;
+
+/// Answers every call on [channel] with [result] and returns the calls.
+List<MethodCall> recordCalls([Object? result = true]) {
+  final calls = <MethodCall>[];
+  messenger.setMockMethodCallHandler(channel, (call) async {
+    calls.add(call);
+    return result;
+  });
+  return calls;
+}
+
+/// Delivers [method] to the plugin as a call from the native side.
+Future<void> callFromPlatform(String method, Object? arguments) {
+  return messenger.handlePlatformMessage(
+    channel.name,
+    channel.codec.encodeMethodCall(MethodCall(method, arguments)),
+    (_) {},
+  );
+}
+
 void main() {
   TestWidgetsFlutterBinding.ensureInitialized();
 
+  // Calls from the platform side reach the first instance that registered
+  // its handler, so every test uses this one.
+  final plugin = SpeechToTextLinux();
+
+  tearDown(() {
+    messenger.setMockMethodCallHandler(channel, null);
+    plugin.listenOptions = {};
+  });
+
   test('registerWith replaces the default platform implementation', () {
     final originalInstance = SpeechToTextPlatform.instance;
     addTearDown(() {
@@ -15,4 +51,279 @@ void main() {
 
     expect(SpeechToTextPlatform.instance, isA<SpeechToTextLinux>());
   });
+
+  group('listen defaults', () {
+    test('initialize sends only the linux options', () async {
+      final calls = recordCalls();
+
+      await plugin.initialize(options: [
+        SpeechConfigOption('linux', 'modelPath', '/opt/vosk/model'),
+        SpeechConfigOption('linux', 'endpointSilenceMillis', 300),
+        SpeechConfigOption('android', 'endpointSilenceMillis', 900),
+      ]);
+
+      expect(calls.single.method, 'initialize');
+      expect(calls.single.arguments, <String, Object?>{
+        'debugLogging': false,
+        'modelPath': '/opt/vosk/model',
+        'endpointSilenceMillis': 300,
+      });
+    });
+
+    test('listen leaves unset linux options to the initialize defaults',
+        () async {
+      final calls = recordCalls();
+
+      await plugin.listen(
+          options: SpeechListenOptions(pauseFor: const Duration(seconds: 2)));
+
+      final args = calls.single.arguments as Map;
+      expect(calls.single.method, 'listen');
+      expect(args['partialResults'], isTrue);
+      expect(args['pauseForMillis'], 2000);
+      expect(args['listenForMillis'], isNull);
+      expect(args.containsKey('endpointSilenceMillis'), isFalse);
+    });
+
+    test('listenOptions override the listen arguments', () async {
+      final calls = recordCalls();
+      plugin.listenOptions = {
+        'endpointSilenceMillis': 500,
+        'partialResults': false,
+      };
+
+      await plugin.listen(options: SpeechListenOptions(partialResults: true));
+
+      final args = calls.single.arguments as Map;
+      expect(args['endpointSilenceMillis'], 500);
+      expect(args['partialResults'], isFalse);
+    });
+  });
+
+  group('pipelined sessions', () {
+    const superseded =
+        '{"alternates":[{"recognizedWords":"next","confidence":0.900}],'
+        '"resultType":2,"sessionId":4,"recognizer":"default"}';
+
+    test('late results of a superseded session keep their sessionId',
+        () async {
+      recordCalls();
+      final current = <String>[];
+      final earlier = <String>[];
+      plugin.onTextRecognition = current.add;
+      plugin.onSessionTextRecognition = earlier.add;
+      await plugin.initialize();
+
+      await callFromPlatform('sessionTextRecognition', superseded);
+
+      expect(current, isEmpty);
+      expect(earlier, <String>[superseded]);
+    });
+
+    test('every session reports its status', () async {
+      recordCalls();
+      final statuses = <String>[];
+      final legacy = <String>[];
+      plugin.onSessionStatus = statuses.add;
+      plugin.onStatus = legacy.add;
+      await plugin.initialize();
+
+      await callFromPlatform(
+          'sessionStatus', '{"sessionId":4,"status":"notListening"}');
+      await callFromPlatform('notifyStatus', 'listening');
+
+      expect(statuses, <String>['{"sessionId":4,"status":"notListening"}']);
+      expect(legacy, <String>['listening']);
+    });
+  });
+
+  group('session handles', () {
+    test('createSession passes its options and returns the handle', () async {
+      final calls = recordCalls(3);
+
+      final handle =
+          await plugin.createSession({'inputDeviceName': 'Headset A'});
+
+      expect(handle, 3);
+      expect(calls.single.method, 'createSession');
+      expect(calls.single.arguments, {'inputDeviceName': 'Headset A'});
+    });
+
+    test('createSession returns null when the native side refuses', () async {
+      messenger.setMockMethodCallHandler(channel, (call) async {
+        throw PlatformException(code: 'not_initialized');
+      });
+
+      expect(await plugin.createSession(), isNull);
+    });
+
+    test('handle calls name the handle as sessionId', () async {
+      final calls = recordCalls();
+
+      await plugin.listenSession(3, {'grammar': <String>['yes', 'no']});
+      await plugin.stopSession(3);
+      await plugin.cancelSession(3);
+      await plugin.destroySession(3);
+
+      expect(calls.map((call) => call.method),
+          <String>['listen', 'stop', 'cancel', 'destroySession']);
+      expect(calls.first.arguments, {
+        'grammar': <String>['yes', 'no'],
+        'sessionId': 3,
+      });
+      for (final call in calls.skip(1)) {
+        expect(call.arguments, {'sessionId': 3});
+      }
+    });
+
+    test('handle sessions report sound levels with their handleId', () async {
+      recordCalls();
+      final levels = <String>[];
+      plugin.onSessionSoundLevel = levels.add;
+      await plugin.initialize();
+
+      await callFromPlatform(
+          'sessionSoundLevel', '{"sessionId":12,"handleId":3,"level":-41.5}');
+
+      expect(levels, <String>['{"sessionId":12,"handleId":3,"level":-41.5}']);
+    });
+  });
+
+  group('setGrammar', () {
+    test('targets the implicit session without a sessionId', () async {
+      final calls = recordCalls();
+
+      expect(await plugin.setGrammar(<String>['yes', 'no']), isTrue);
+
+      expect(calls.single.method, 'setGrammar');
+      expect(calls.single.arguments, {
+        'grammar': <String>['yes', 'no'],
+      });
+    });
+
+    test('names a handle session as sessionId', () async {
+      final calls = recordCalls();
+
+      await plugin.setGrammar(<String>['open settings'], sessionId: 3);
+
+      expect(calls.single.arguments, {
+        'grammar': <String>['open settings'],
+        'sessionId': 3,
+      });
+    });
+
+    test('returns false when no grammar session is listening', () async {
+      recordCalls(false);
+      expect(await plugin.setGrammar(<String>['yes']), isFalse);
+
+      messenger.setMockMethodCallHandler(channel, (call) async {
+        throw PlatformException(code: 'unknown_session');
+      });
+      expect(await plugin.setGrammar(<String>['yes'], sessionId: 9), isFalse);
+    });
+  });
+
+  group('LinuxWordTimings.fromMap', () {
+    test('reads the typed lists of a textRecognitionWords payload', () {
+      final timings = LinuxWordTimings.fromMap(<Object?, Object?>{
+        'sessionId': 7,
+        'handleId': 2,
+        'recognizer': 'default',
+        'words': <Object?>['turn', 'left'],
+        'start': Float64List.fromList(<double>[61.2, 61.5]),
+        'end': Float64List.fromList(<double>[61.45, 61.9]),
+        'conf': Float32List.fromList(<double>[0.9, 0.75]),
+      });
+
+      expect(timings.sessionId, 7);
+      expect(timings.handleId, 2);
+      expect(timings.recognizer, 'default');
+      expect(timings.words, <String>['turn', 'left']);
+      expect(timings.start, <double>[61.2, 61.5]);
+      expect(timings.end, <double>[61.45, 61.9]);
+      expect(timings.confidence[0], closeTo(0.9, 1e-6));
+      expect(timings.confidence[1], closeTo(0.75, 1e-6));
+    });
+
+    test('falls back to empty lists when fields are missing', () {
+      final timings = LinuxWordTimings.fromMap(<Object?, Object?>{});
+
+      expect(timings.sessionId, 0);
+      expect(timings.handleId, 0);
+      expect(timings.recognizer, '');
+      expect(timings.words, isEmpty);
+      expect(timings.start, isEmpty);
+      expect(timings.end, isEmpty);
+      expect(timings.confidence, isEmpty);
+    });
+
+    test('is delivered through onWordTimings', () async {
+      messenger.setMockMethodCallHandler(channel, (call) async => true);
+      LinuxWordTimings? received;
+      plugin.onWordTimings = (timings) => received = timings;
+      // Registers the handler for calls from the platform side.
+      await plugin.initialize();
+
+      await callFromPlatform('textRecognitionWords', <Object?, Object?>{
+        'sessionId': 1,
+        'recognizer': 'default',
+        'words': <Object?>['hello'],
+        'start': Float64List.fromList(<double>[0.3]),
+        'end': Float64List.fromList(<double>[0.6]),
+        'conf': Float32List.fromList(<double>[1.0]),
+      });
+
+      expect(received?.words, <String>['hello']);
+      expect(received?.start, <double>[0.3]);
+    });
+  });
+
+  group('LinuxAudioSpan.fromMap', () {
+    test('reads a textRecognitionSpan payload', () {
+      final span = LinuxAudioSpan.fromMap(<Object?, Object?>{
+        'sessionId': 7,
+        'handleId': 2,
+        'recognizer': 'commands',
+        'final': true,
+        'audioStartMillis': 1234567.25,
+        'audioEndMillis': 1236789.5,
+      });
+
+      expect(span.sessionId, 7);
+      expect(span.handleId, 2);
+      expect(span.recognizer, 'commands');
+      expect(span.isFinal, isTrue);
+      expect(span.audioStartMillis, 1234567.25);
+      expect(span.audioEndMillis, 1236789.5);
+    });
+
+    test('marks missing times as unknown', () {
+      final span = LinuxAudioSpan.fromMap(<Object?, Object?>{});
+
+      expect(span.sessionId, 0);
+      expect(span.handleId, 0);
+      expect(span.isFinal, isFalse);
+      expect(span.audioStartMillis, -1);
+      expect(span.audioEndMillis, -1);
+    });
+
+    test('is delivered through onAudioSpan', () async {
+      messenger.setMockMethodCallHandler(channel, (call) async => true);
+      LinuxAudioSpan? received;
+      plugin.onAudioSpan = (span) => received = span;
+      await plugin.initialize();
+
+      await callFromPlatform('textRecognitionSpan', <Object?, Object?>{
+        'sessionId': 1,
+        'recognizer': 'default',
+        'final': false,
+        'audioStartMillis': 5000.0,
+        'audioEndMillis': 5640.0,
+      });
+
+      expect(received?.isFinal, isFalse);
+      expect(received?.audioStartMillis, 5000.0);
+      expect(received?.audioEndMillis, 5640.0);
+    });
+  });
 }